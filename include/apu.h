@@ -1,12 +1,24 @@
 #pragma once
 
+#include <array>
+#include <climits>
+#include <vector>
+
+#include "audio_ring.h"
+#include "blip_buffer.h"
 #include "bus.h"
 #include "types.h"
 
 namespace nes {
 class apu {
 public:
+  // Rate of the samples each frame produces
+  static constexpr int sample_rate = 48000;
+
+  apu();
+
   void set_bus(nes::bus&);
+  void set_output(nes::audio_ring*);
 
   void power_on();
 
@@ -14,8 +26,150 @@ public:
   void    write(const int, uint16_t, uint8_t);
 
   void run_frame(int);
+  void run_event(const event_type::event_type);
+
+  // Mono samples of the last frame run
+  const std::vector<int16_t>& samples() const;
 
 private:
   nes::bus* bus = nullptr;
+
+  // Where each frame's samples go to be played, nullptr keeps them here
+  nes::audio_ring* audio = nullptr;
+
+  //
+  // Channels only run when something needs them to: a register access, an
+  // IRQ coming due, or the end of the frame. They are then stepped from one
+  // clock of their timers to the next, in order, up to that cycle, and each
+  // change of the mixed output goes into the blip buffer at the cycle it
+  // happens. Times are CPU cycles from the start of the frame, as
+  // cpu::elapsed() counts them
+  //
+
+  static constexpr int never = INT_MAX;
+
+  struct envelope_unit {
+    bool    start    = false;
+    bool    loop     = false;  // Also halts the length counter
+    bool    constant = false;
+    uint8_t period   = 0;  // Also the constant volume
+    uint8_t divider  = 0;
+    uint8_t decay    = 0;
+
+    void    clock();
+    uint8_t volume() const;
+  };
+
+  struct pulse_channel {
+    envelope_unit envelope;
+
+    bool     enabled = false;
+    uint8_t  duty    = 0;
+    uint8_t  step    = 0;
+    uint16_t period  = 0;
+    uint8_t  length  = 0;
+    int      next    = never;  // Next timer clock, never while silent
+
+    bool    sweep_enabled = false;
+    bool    sweep_negate  = false;
+    bool    sweep_reload  = false;
+    uint8_t sweep_period  = 0;
+    uint8_t sweep_shift   = 0;
+    uint8_t sweep_divider = 0;
+    uint8_t sweep_carry   = 0;  // Pulse 1 negates in ones' complement
+
+    int     sweep_target() const;
+    bool    muted() const;
+    uint8_t output() const;
+  };
+
+  struct triangle_channel {
+    bool     enabled       = false;
+    bool     control       = false;  // Also halts the length counter
+    bool     reload        = false;
+    uint8_t  linear        = 0;
+    uint8_t  linear_period = 0;
+    uint8_t  step          = 0;
+    uint16_t period        = 0;
+    uint8_t  length        = 0;
+    int      next          = never;
+  };
+
+  struct noise_channel {
+    envelope_unit envelope;
+
+    bool     enabled = false;
+    bool     mode    = false;
+    uint16_t shift   = 1;
+    uint16_t period  = 0;
+    uint8_t  length  = 0;
+    int      next    = never;
+
+    uint8_t output() const;
+  };
+
+  struct dmc_channel {
+    bool     irq_enabled = false;
+    bool     loop        = false;
+    uint16_t period      = 0;
+    uint8_t  level       = 0;
+    int      next        = never;
+
+    uint16_t sample_addr   = 0;
+    uint16_t sample_length = 0;
+    uint16_t addr          = 0;
+    uint16_t remaining     = 0;  // Bytes still to fetch
+
+    uint8_t buffer      = 0;
+    bool    buffer_full = false;
+    uint8_t shift       = 0;
+    uint8_t bits        = 8;
+    bool    silent      = true;
+  };
+
+  std::array<pulse_channel, 2> pulses;
+  triangle_channel             triangle;
+  noise_channel                noise;
+  dmc_channel                  dmc;
+
+  // Frame counter, one sequence of steps after another from frame_start
+  bool   five_step   = false;
+  bool   irq_inhibit = false;
+  bool   frame_irq   = false;
+  bool   dmc_irq     = false;
+  int    frame_start = 0;
+  size_t frame_index = 0;
+  int    frame_next  = 0;
+
+  // Cycle the channels are caught up to, and the CPU cycle count at the
+  // start of the frame
+  int      time = 0;
+  uint64_t base = 0;
+
+  nes::blip_buffer     blip;
+  int                  amplitude = 0;
+  std::vector<int16_t> output;
+
+  void run_to(const int);
+  void mix(const int);
+
+  void clock_frame(const int);
+  void quarter_frame();
+  void half_frame();
+  void clock_pulse(pulse_channel&, const int);
+  void clock_triangle(const int);
+  void clock_noise(const int);
+  void clock_dmc(const int);
+  void fetch_sample();
+
+  void arm_pulse(pulse_channel&);
+  void arm_triangle();
+  void arm_noise();
+  void write_pulse(pulse_channel&, const uint16_t, const uint8_t);
+  void set_frame_counter(const uint8_t);
+
+  void update_irq();
+  void schedule_frame_irq();
+  void schedule_dmc_irq();
 };
-}  // namespace nes
\ No newline at end of file
+}  // namespace nes
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+
+#include "types.h"
+
+namespace nes {
+
+//
+// Samples on their way from the emulation thread to the audio callback.
+// One thread pushes and one pops, neither ever waits on the other: each
+// side only writes its own index and reads the other's. What doesn't fit
+// is dropped, and what isn't there when the callback asks is filled in
+// with the last sample, both counted
+//
+
+class audio_ring {
+public:
+  explicit audio_ring(const size_t = 0x2000);  // Rounded up to a power of 2
+
+  // Producer side, returns how many went in
+  size_t push(const int16_t*, const size_t);
+
+  // Consumer side, always fills the whole buffer. Returns how many came
+  // from the ring
+  size_t pop(int16_t*, const size_t);
+
+  size_t capacity() const;
+  size_t size() const;
+
+  // Samples dropped for lack of room, and missing when the callback came
+  uint64_t overruns() const;
+  uint64_t underruns() const;
+
+private:
+  std::unique_ptr<int16_t[]> samples;
+  size_t                     mask = 0;
+
+  // Each side on a cache line of its own, so the two threads don't keep
+  // taking it from each other
+  alignas(64) std::atomic<size_t> head = 0;  // Next to push
+  std::atomic<uint64_t> dropped        = 0;
+
+  alignas(64) std::atomic<size_t> tail = 0;  // Next to pop
+  std::atomic<uint64_t> missing        = 0;
+  int16_t               last           = 0;
+};
+}  // namespace nes
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <array>
+#include <vector>
+
+#include "types.h"
+
+namespace nes {
+
+//
+// Band-limited step synthesis. Sources only say when their output changes
+// and by how much, in clocks from the start of the frame, and each change
+// goes in as a windowed sinc step at its exact position between samples.
+// Samples are summed up from those steps as they're read, with the DC taken
+// out, so nothing has to run once per clock
+//
+
+class blip_buffer {
+public:
+  blip_buffer(const double, const int, const int);  // Clock rate, sample
+                                                    // rate, clocks a frame
+
+  void add_delta(const int, const int);
+
+  // Makes the samples up to this many clocks into the frame readable, the
+  // next frame starting there
+  void end_frame(const int);
+
+  // Appends the readable samples
+  void read_samples(std::vector<int16_t>&);
+
+private:
+  static constexpr int taps        = 16;
+  static constexpr int phase_bits  = 5;
+  static constexpr int phases      = 1 << phase_bits;
+  static constexpr int kernel_bits = 15;
+  static constexpr int bass_shift  = 9;  // High-pass at about 15 Hz
+
+  using kernel = std::array<std::array<int32_t, taps>, phases>;
+
+  // Position in samples of the start of the frame, 32 bits of it fraction,
+  // and how far each clock moves it
+  uint64_t offset = 0;
+  uint64_t factor = 0;
+
+  std::vector<int32_t> deltas;
+  kernel               steps{};
+  int32_t              integrator = 0;
+
+  static kernel make_steps();
+};
+}  // namespace nes
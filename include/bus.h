@@ -1,5 +1,7 @@
 #pragma once
 
+#include <filesystem>
+
 #include "types.h"
 
 namespace nes {
@@ -10,6 +12,7 @@ class cartridge;
 class controller;
 class debugger;
 class emulator;
+struct frame;
 
 class bus {
 public:
@@ -25,18 +28,32 @@ public:
   // CPU access
   //
 
-  void run_frame();
-  void set_nmi(const bool = true);
-  void set_irq(const bool = true);
+  void     run_frame();
+  uint64_t cpu_cycles() const;
+  void     map_cpu_memory(const uint16_t, const size_t, const uint8_t*, uint8_t*);
+  void     set_nmi(const bool = true);
+  void     set_irq(const bool = true);
+  void     dump_trace(const std::filesystem::path&) const;
+
+  //
+  // Scheduler access
+  //
+
+  void schedule(const event_type::event_type, const uint64_t);
+  void cancel(const event_type::event_type);
+  void run_event(const event_type::event_type);
 
   //
   // PPU access
   //
 
-  void    ppu_step();
-  uint8_t ppu_read(const uint16_t);
-  void    ppu_write(const uint16_t, const uint8_t);
-  void    set_mirroring(const int);
+  uint64_t ppu_sync();
+  uint8_t  ppu_read(const uint16_t);
+  void     ppu_write(const uint16_t, const uint8_t);
+  void     set_mirroring(const int);
+  void     oam_dma(const uint8_t*);
+  void     map_chr_memory(const uint16_t, const size_t, const uint8_t*, uint8_t*);
+  void     chr_map_changed(const uint16_t, const size_t);
 
   //
   // APU access
@@ -50,9 +67,7 @@ public:
 
   uint8_t prg_read(const uint16_t) const;
   void    prg_write(const uint16_t, const uint8_t);
-
-  uint8_t chr_read(const uint16_t) const;
-  void    chr_write(const uint16_t, const uint8_t);
+  int     prg_bank(const uint16_t) const;
 
   //
   // Controller access
@@ -71,7 +86,7 @@ public:
   // Emulator access
   //
 
-  void    update_frame(const uint32_t*);
+  void    update_frame(const nes::frame&);
   uint8_t get_controller(const size_t) const;
 
 private:
@@ -15,10 +15,11 @@ public:
   void load(const std::filesystem::path&);
 
   uint8_t prg_read(const uint16_t) const;
-  uint8_t chr_read(const uint16_t) const;
+  int     prg_bank(const uint16_t) const;
 
   void prg_write(const uint16_t, const uint8_t);
-  void chr_write(const uint16_t, const uint8_t);
+
+  void run_event();
 
 private:
   nes::bus*                    bus = nullptr;
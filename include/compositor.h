@@ -0,0 +1,36 @@
+#pragma once
+
+#include "types.h"
+
+namespace nes {
+//
+// Pixel kernels of the PPU and of the frame conversion. Both layers of a
+// line are one byte per pixel, 0 where transparent. Background pixels are
+// palette indexes (0x00-0x0F), sprite pixels keep theirs (0x10-0x1F) in the
+// low 5 bits and the flags below in the high ones
+//
+
+namespace sprite_pixel {
+enum sprite_pixel : uint8_t { Behind = 0x20, Zero = 0x40 };
+}
+
+struct compositor {
+  static constexpr int width = 256;
+
+  // Merges a line of background and sprite pixels into palette indexes,
+  // blanking the leftmost 8 pixels of the layers that are clipped. Returns
+  // the first x where sprite 0 hits the background, -1 if it doesn't
+  using line_fn = int (*)(const uint8_t*, const uint8_t*, uint8_t*,
+                          const bool, const bool);
+
+  // Looks the 6-bit colour of each pixel of a line up in a 64-entry table
+  using convert_fn = void (*)(const uint8_t*, const uint32_t*, uint32_t*);
+
+  const char* name;
+  line_fn     composite;
+  convert_fn  convert;
+
+  // The fastest version the host runs, picked with cpuid on first use
+  static const compositor& best();
+};
+}  // namespace nes
@@ -1,14 +1,21 @@
 #pragma once
 
 #include <array>
+#include <unordered_map>
+#include <vector>
 
 #include "bus.h"
+#include "profiler.h"
+#include "scheduler.h"
+#include "trace.h"
 #include "types.h"
 
 namespace nes {
 
 class cpu {
 public:
+  cpu();
+
   void set_bus(nes::bus&);
   void power_on();
   void reset();
@@ -18,6 +25,23 @@ public:
   void set_irq(const bool = true);
 
   void run_frame();
+  void use_block_cache(const bool = true);
+  void skip_idle_loops(const bool = true);
+  void set_accuracy(const accuracy::accuracy);
+  void set_trace(nes::trace_ring*);
+  void dump_trace(const std::filesystem::path&) const;
+
+#ifdef NES_PROFILER
+  void set_profiler(nes::profiler*);
+#endif
+
+  uint64_t cycles() const;
+  int      frame_cycles() const;
+
+  void schedule(const event_type::event_type, const uint64_t);
+  void cancel(const event_type::event_type);
+
+  void map_memory(const uint16_t, const size_t, const uint8_t*, uint8_t*);
 
   friend class debugger;
 
@@ -27,13 +51,49 @@ private:
   nes::state                 state;
   std::array<uint8_t, 0x800> ram = {};
 
-  void tick();
+  //
+  // Memory map, one descriptor per 256 byte page. Pages backed by host
+  // memory are accessed through their pointers, the rest through handlers
+  //
+
+  using read_handler  = uint8_t (*)(const nes::cpu&, const uint16_t);
+  using write_handler = void (*)(nes::cpu&, const uint16_t, const uint8_t);
+
+  struct code_page;
+
+  struct memory_page {
+    const uint8_t* read     = nullptr;
+    uint8_t*       write    = nullptr;
+    read_handler   on_read  = nullptr;
+    write_handler  on_write = nullptr;
+
+    code_page* code       = nullptr;  // Decoded blocks for this mapping
+    uint8_t*   code_write = nullptr;  // Write pointer held back while the
+                                      // page has decoded code
+  };
+
+  std::array<memory_page, 0x100> pages;
+
+  static uint8_t read_ppu(const nes::cpu&, const uint16_t);
+  static uint8_t read_io(const nes::cpu&, const uint16_t);
+  static uint8_t read_cartridge(const nes::cpu&, const uint16_t);
+
+  static void write_ppu(nes::cpu&, const uint16_t, const uint8_t);
+  static void write_io(nes::cpu&, const uint16_t, const uint8_t);
+  static void write_cartridge(nes::cpu&, const uint16_t, const uint8_t);
+
+  void write_code(const uint16_t, const uint8_t);
+  void clear_ram();
+
+  template <auto Accuracy> void tick();
+  void                      tick(const int);
+  void ppu_sync();
 
   uint8_t read(const uint16_t) const;
   void    write(const uint16_t, const uint8_t);
 
-  uint8_t memory_read(const uint16_t);
-  void    memory_write(const uint16_t, const uint8_t);
+  template <auto Accuracy> uint8_t memory_read(const uint16_t);
+  template <auto Accuracy> void    memory_write(const uint16_t, const uint8_t);
 
   uint8_t peek(const uint16_t addr) const;
 
@@ -49,17 +109,112 @@ private:
   uint16_t peek_indx() const;
   uint16_t peek_indy() const;
 
+  // Flight recorder, fed before every instruction while it's set
+  nes::trace_ring* trace = nullptr;
+
+  void trace_instruction();
+
   int elapsed() const;
 
-  const int total_cycles     = 29781;
-  int       remaining_cycles = 0;
+  const int total_cycles = 29781;
+  uint64_t  frame_end    = 0;
+
+  // Timed events. The run loop only stops to look at them, and at pending
+  // interrupts, once the cycle count reaches next_event
+  nes::scheduler events;
+  uint64_t       next_event = 0;
 
   //
   // All functions defined here are
   // implemented in cpu_instructions.cpp
   //
 
-  void execute();
+  using opcode_handler = void (*)(nes::cpu&);
+
+  accuracy::accuracy accuracy_mode = accuracy::Cycle;
+
+  template <void (cpu::*Instruction)()> static void invoke(nes::cpu&);
+
+  template <auto Accuracy>
+  static constexpr std::array<opcode_handler, 0x100> opcode_table();
+
+  template <auto Accuracy> void run();
+  template <auto Accuracy = accuracy::Cycle> void execute();
+  template <auto Accuracy> bool handle_events();
+  void                          recheck_interrupts();
+
+#ifdef NES_PROFILER
+  // A profiled frame runs through execute() one instruction at a time,
+  // so the regular loops stay exactly as they are without it
+  nes::profiler* profiler = nullptr;
+
+  template <auto Accuracy> void run_profiled();
+#endif
+
+  //
+  // Block cache. Straight-line code is decoded once into runs of handlers,
+  // along with their operand bytes. Blocks are keyed by the host memory the
+  // code lives in, so the current bank mapping picks the blocks, and a
+  // write to decoded RAM code throws that page's blocks away
+  //
+
+  static constexpr uint16_t no_block = 0xFFFF;
+
+  struct block_entry {
+    opcode_handler         handler  = nullptr;
+    uint8_t                opcode   = 0;
+    bool                   last     = false;
+    bool                   split    = false;  // Operand in the next page
+    std::array<uint8_t, 2> operands = {};
+  };
+
+  struct code_page {
+    std::array<uint16_t, 0x100> block_at;  // First entry of the block
+    std::vector<block_entry>    entries;
+  };
+
+  bool block_cache   = false;
+  bool code_modified = false;
+
+  // Operand bytes of the block entry running, nullptr when they have to be
+  // fetched. Writes to decoded code drop the block, so they can't go stale
+  const uint8_t* operands = nullptr;
+
+  std::unordered_map<const uint8_t*, code_page> code_cache;
+
+  template <auto Accuracy> void run_cached();
+  bool                          interrupted() const;
+
+  template <auto Accuracy> const block_entry* find_block(const uint16_t);
+  template <auto Accuracy>
+  uint16_t decode_block(code_page&, const uint8_t*, const uint8_t);
+
+  void protect_code(const uint8_t*);
+  void invalidate_code(const uint8_t*);
+
+  //
+  // Idle loop detection. A short backward loop that only reads RAM, ROM or
+  // PPUSTATUS and comes round with the same registers can't change anything
+  // until the next deadline, so the iterations before it are skipped at once
+  //
+
+  struct idle_loop {
+    bool     active     = false;
+    bool     pure       = false;  // Body passed the static check
+    uint16_t head       = 0;
+    uint16_t branch     = 0;  // Address of the backward branch or jump
+    int      iterations = 0;  // Completed since the deadline last moved
+
+    uint64_t deadline = 0;
+    uint64_t cycle    = 0;  // Snapshot of the last arrival at the branch
+    uint8_t  a = 0, x = 0, y = 0, sp = 0, ps = 0;
+  };
+
+  bool      idle_skip = false;
+  idle_loop idle;
+
+  void loop_back(const uint16_t);
+  bool idle_body(const uint16_t, const uint16_t) const;
 
   /* Instructions */
 
@@ -67,7 +222,10 @@ private:
   // Auxiliary
   //
 
-  template <auto Mode> uint16_t get_operand();
+  template <auto Accuracy> uint8_t fetch();
+
+  template <auto Accuracy, auto Mode> uint8_t  read_operand();
+  template <auto Accuracy, auto Mode> uint16_t get_operand();
 
   void    add(const uint8_t);
   uint8_t shift_left(const uint8_t);   // Arithmetic left shift
@@ -77,10 +235,10 @@ private:
 
   void compare(const uint8_t, const uint8_t);
 
-  void branch(const bool);
+  template <auto Accuracy> void branch(const bool);
 
-  void    push(const uint8_t);
-  uint8_t pop();
+  template <auto Accuracy> void    push(const uint8_t);
+  template <auto Accuracy> uint8_t pop();
 
   bool crosses_page(const uint16_t, const uint8_t) const;
   bool crosses_page(const uint16_t, const int8_t) const;
@@ -89,114 +247,126 @@ private:
   // Storage
   //
 
-  template <auto Mode> void LDA();
-  template <auto Mode> void LDX();
-  template <auto Mode> void LDY();
+  template <auto Accuracy, auto Mode> void LDA();
+  template <auto Accuracy, auto Mode> void LDX();
+  template <auto Accuracy, auto Mode> void LDY();
 
-  template <auto Mode> void STA();
-  template <auto Mode> void STX();
-  template <auto Mode> void STY();
+  template <auto Accuracy, auto Mode> void STA();
+  template <auto Accuracy, auto Mode> void STX();
+  template <auto Accuracy, auto Mode> void STY();
 
-  void TAX();
-  void TAY();
-  void TSX();
-  void TXA();
-  void TXS();
-  void TYA();
+  template <auto Accuracy> void TAX();
+  template <auto Accuracy> void TAY();
+  template <auto Accuracy> void TSX();
+  template <auto Accuracy> void TXA();
+  template <auto Accuracy> void TXS();
+  template <auto Accuracy> void TYA();
 
   //
   // Math
   //
 
-  template <auto Mode> void ADC();
-  template <auto Mode> void SBC();
-  template <auto Mode> void INC();
-  template <auto Mode> void DEC();
-  void                      INX();
-  void                      INY();
-  void                      DEX();
-  void                      DEY();
+  template <auto Accuracy, auto Mode> void ADC();
+  template <auto Accuracy, auto Mode> void SBC();
+  template <auto Accuracy, auto Mode> void INC();
+  template <auto Accuracy, auto Mode> void DEC();
+  template <auto Accuracy> void            INX();
+  template <auto Accuracy> void            INY();
+  template <auto Accuracy> void            DEX();
+  template <auto Accuracy> void            DEY();
 
   //
   // Bitwise
   //
 
-  template <auto Mode> void AND();
-  template <auto Mode> void ORA();
-  template <auto Mode> void EOR();
-  template <auto Mode> void LSR();
-  template <auto Mode> void ASL();
-  template <auto Mode> void ROL();
-  template <auto Mode> void ROR();
+  template <auto Accuracy, auto Mode> void AND();
+  template <auto Accuracy, auto Mode> void ORA();
+  template <auto Accuracy, auto Mode> void EOR();
+  template <auto Accuracy, auto Mode> void LSR();
+  template <auto Accuracy, auto Mode> void ASL();
+  template <auto Accuracy, auto Mode> void ROL();
+  template <auto Accuracy, auto Mode> void ROR();
 
   //
   // Flags
   //
 
-  void CLC();
-  void CLD();
-  void CLI();
-  void CLV();
-  void SEC();
-  void SED();
-  void SEI();
+  template <auto Accuracy> void CLC();
+  template <auto Accuracy> void CLD();
+  template <auto Accuracy> void CLI();
+  template <auto Accuracy> void CLV();
+  template <auto Accuracy> void SEC();
+  template <auto Accuracy> void SED();
+  template <auto Accuracy> void SEI();
 
-  template <auto Mode> void CMP();
-  template <auto Mode> void CPX();
-  template <auto Mode> void CPY();
-  template <auto Mode> void BIT();
+  template <auto Accuracy, auto Mode> void CMP();
+  template <auto Accuracy, auto Mode> void CPX();
+  template <auto Accuracy, auto Mode> void CPY();
+  template <auto Accuracy, auto Mode> void BIT();
 
   //
   // Jumps and branches
   //
 
-  template <auto Mode> void JMP();
-  void                      JSR();
-  void                      RTS();
-  void                      RTI();
+  template <auto Accuracy, auto Mode> void JMP();
+  template <auto Accuracy> void            JSR();
+  template <auto Accuracy> void            RTS();
+  template <auto Accuracy> void            RTI();
 
-  void BCC();
-  void BCS();
-  void BEQ();
-  void BMI();
-  void BNE();
-  void BPL();
-  void BVC();
-  void BVS();
+  template <auto Accuracy> void BCC();
+  template <auto Accuracy> void BCS();
+  template <auto Accuracy> void BEQ();
+  template <auto Accuracy> void BMI();
+  template <auto Accuracy> void BNE();
+  template <auto Accuracy> void BPL();
+  template <auto Accuracy> void BVC();
+  template <auto Accuracy> void BVS();
 
   //
   // Stack
   //
 
-  void PHA();
-  void PLA();
-  void PHP();
-  void PLP();
+  template <auto Accuracy> void PHA();
+  template <auto Accuracy> void PLA();
+  template <auto Accuracy> void PHP();
+  template <auto Accuracy> void PLP();
 
   //
   // System
   //
 
-  void INT_NMI();
-  void INT_RST();
-  void INT_IRQ();
-  void INT_BRK();
+  template <auto Accuracy = accuracy::Cycle> void INT_NMI();
+  template <auto Accuracy = accuracy::Cycle> void INT_RST();
+  template <auto Accuracy = accuracy::Cycle> void INT_IRQ();
+  template <auto Accuracy = accuracy::Cycle> void INT_BRK();
 
-  void NOP();
+  template <auto Accuracy> void NOP();
 
   //
   // Unofficial instructions
   //
 
-  template <auto Mode> void NOP();
-  template <auto Mode> void LAX();  // LDA then TXA
-  template <auto Mode> void SAX();  // A & X
-  template <auto Mode> void DCP();  // DEC then CMP
-  template <auto Mode> void ISB();  // INC then SBC
-  template <auto Mode> void SLO();  // ASL then ORA
-  template <auto Mode> void RLA();  // ROL then AND
-  template <auto Mode> void SRE();  // LSR then EOR
-  template <auto Mode> void RRA();  // ROR then ADC
+  template <auto Accuracy, auto Mode> void NOP();
+  template <auto Accuracy, auto Mode> void LAX();  // LDA then TXA
+  template <auto Accuracy, auto Mode> void SAX();  // A & X
+  template <auto Accuracy, auto Mode> void DCP();  // DEC then CMP
+  template <auto Accuracy, auto Mode> void ISB();  // INC then SBC
+  template <auto Accuracy, auto Mode> void SLO();  // ASL then ORA
+  template <auto Accuracy, auto Mode> void RLA();  // ROL then AND
+  template <auto Accuracy, auto Mode> void SRE();  // LSR then EOR
+  template <auto Accuracy, auto Mode> void RRA();  // ROR then ADC
+  template <auto Accuracy, auto Mode> void ANC();  // AND then copy N to C
+  template <auto Accuracy, auto Mode> void ALR();  // AND then LSR
+  template <auto Accuracy, auto Mode> void ARR();  // AND then ROR
+  template <auto Accuracy, auto Mode> void AXS();  // (A & X) - value into X
+  template <auto Accuracy, auto Mode> void LAS();  // value & SP into A, X, SP
+  template <auto Accuracy, auto Mode> void XAA();  // X & value into A, unstable
+  template <auto Accuracy, auto Mode> void AHX();  // A & X & (H + 1), unstable
+  template <auto Accuracy, auto Mode> void TAS();  // A & X into SP, then AHX
+  template <auto Accuracy, auto Mode> void SHX();  // X & (H + 1), unstable
+  template <auto Accuracy, auto Mode> void SHY();  // Y & (H + 1), unstable
+
+  template <auto Accuracy> void JAM();  // Halts the CPU until reset
 };
 
 }  // namespace nes
\ No newline at end of file
@@ -1,8 +1,10 @@
 #pragma once
 
-#include <fstream>
+#include <filesystem>
+#include <memory>
 
 #include "cpu.h"
+#include "golden.h"
 #include "types.h"
 
 namespace nes {
@@ -12,28 +14,15 @@ public:
 
   void nestest();
 
+  // Checks every instruction the cpu traces from now on against a
+  // reference log, stopping the emulator where they part
+  void compare(const std::filesystem::path&);
+  void check();
+
 private:
-  std::ofstream   nestest_log{"../roms/nestest_out.log"};
-  const nes::cpu& cpu;
+  std::filesystem::path nestest_trace{"../roms/nestest_out.trace"};
+  const nes::cpu&       cpu;
 
-  enum addr_mode2 {
-    impl,
-    acc,
-    imm,
-    zp,
-    zpx,
-    zpy,
-    rel,
-    ab,
-    abx,
-    abx_,
-    aby,
-    aby_,
-    ind,
-    indx,
-    indy,
-    indy_,
-    inv
-  };
+  std::unique_ptr<nes::golden_trace> golden;
 };
 }  // namespace nes
@@ -16,7 +16,10 @@
 #pragma clang diagnostic pop
 #endif
 
+#include "audio_ring.h"
 #include "bus.h"
+#include "frame.h"
+#include "timer.h"
 #include "types.h"
 
 namespace SDL2 {
@@ -57,9 +60,10 @@ public:
   void close();
 
   void set_bus(nes::bus&);
+  void set_audio(nes::audio_ring*);
 
   uint8_t get_controller(const size_t) const;
-  void    update_frame(const uint32_t*);
+  void    update_frame(const nes::frame&);
   void    draw();
 
   void run();
@@ -70,9 +74,32 @@ private:
   const unsigned width  = 256;
   const unsigned height = 240;
 
+  // NTSC, for the frames that aren't presented and so don't wait on vsync
+  const float frame_time = 1 / 60.0988f;
+
   SDL2::Window   window;
   SDL2::Renderer renderer;
   SDL2::Texture  texture;
+
+  // The last finished frame, turned into RGBA when it's drawn
+  const nes::frame* pending = nullptr;
+
+  // The texture holds the frame before the pending one, so only the lines
+  // that changed since need uploading. Not so at first, or after a frame
+  // went by without being drawn
+  bool texture_current = false;
+
+  // The window has to be drawn again even if the frame is the same
+  bool redraw = true;
+
+  nes::timer frame_timer;
+
+  // Pulled from the ring on SDL's audio thread
+  SDL_AudioDeviceID audio_device = 0;
+
+  static void play(void*, Uint8*, int);
+
+  bool upload(const nes::frame&);
   const uint8_t* keys;
 
   SDL_Scancode KEY_A[2]      = {SDL_SCANCODE_A, SDL_SCANCODE_ESCAPE};
@@ -83,5 +110,7 @@ private:
   SDL_Scancode KEY_DOWN[2]   = {SDL_SCANCODE_DOWN, SDL_SCANCODE_ESCAPE};
   SDL_Scancode KEY_LEFT[2]   = {SDL_SCANCODE_LEFT, SDL_SCANCODE_ESCAPE};
   SDL_Scancode KEY_RIGHT[2]  = {SDL_SCANCODE_RIGHT, SDL_SCANCODE_ESCAPE};
+
+  SDL_Scancode KEY_DUMP_TRACE = SDL_SCANCODE_F12;
 };
 }  // namespace nes
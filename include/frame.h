@@ -0,0 +1,32 @@
+#pragma once
+
+#include <array>
+#include <bitset>
+
+#include "types.h"
+
+namespace nes {
+//
+// A picture as the PPU draws it, one byte per pixel holding the 6-bit
+// colour read from palette RAM. The emphasis bits of PPUMASK only change
+// between lines as far as the renderer goes, so they are kept per line.
+// Nothing is turned into RGBA until somebody shows the frame
+//
+
+struct frame {
+  static constexpr int width  = 256;
+  static constexpr int height = 240;
+
+  std::array<uint8_t, width * height> pixels{};
+  std::array<uint8_t, height>         emphasis{};  // PPUMASK >> 5
+
+  // Lines that aren't the same as in the frame before this one
+  std::bitset<height> dirty;
+
+  // Converts a run of lines, all of them by default, to
+  // SDL_PIXELFORMAT_RGBA32. The first goes to the start of the buffer and
+  // each next one a pitch (in pixels) further
+  void to_rgba(uint32_t*, const size_t = width, const int = 0,
+               const int = height) const;
+};
+}  // namespace nes
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <array>
+#include <filesystem>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+#include "trace.h"
+#include "types.h"
+
+namespace nes {
+
+//
+// Reference log, nestest.log or a Mesen trace, mapped into memory and
+// walked one line per traced instruction. Only the CPU state is compared:
+// pc, opcode, registers, flags other than B and bit 5, and the cycle when
+// the log has a count the record can be checked against
+//
+
+namespace golden_state {
+enum golden_state { Matching, Diverged, Finished };
+}
+
+class golden_trace {
+public:
+  explicit golden_trace(const std::filesystem::path&);
+  ~golden_trace();
+
+  golden_trace(const golden_trace&)            = delete;
+  golden_trace& operator=(const golden_trace&) = delete;
+
+  // Goes through what the ring got since the last call. Stops at the first
+  // instruction that doesn't match the log, or when the log runs out
+  golden_state::golden_state follow(const trace_ring&);
+
+  // The lines and records leading up to the divergence, then what differs
+  void report(std::ostream&, const trace_ring&) const;
+
+  uint64_t matched() const;
+
+private:
+  static constexpr size_t context = 8;
+
+  struct reference_line {
+    uint16_t pc     = 0;
+    uint8_t  opcode = 0;
+    uint8_t  a = 0, x = 0, y = 0, p = 0, sp = 0;
+    bool     has_cycle = false;
+    bool     ppu_dot   = false;  // Old nestest logs count PPU dots in CYC
+    uint64_t cycle     = 0;
+  };
+
+  const char* data = nullptr;
+  size_t      size = 0;
+  std::string fallback;  // Holds the file where it can't be mapped
+
+  const char* cursor = nullptr;
+  uint64_t    next   = 0;  // Ring index of the next record, also lines matched
+
+  golden_state::golden_state state = golden_state::Matching;
+
+  // The last lines that matched, by ring index modulo context
+  std::array<std::string_view, context> previous;
+  std::string_view                      failed_line;
+  reference_line                        expected;
+  trace_record                          actual;
+
+  bool next_line(std::string_view&);
+
+  static bool parse(std::string_view, reference_line&);
+  static bool matches(const reference_line&, const trace_record&);
+  static std::string differences(const reference_line&, const trace_record&);
+};
+
+}  // namespace nes
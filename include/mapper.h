@@ -20,16 +20,20 @@ public:
   void set_bus(nes::bus&);
 
   uint8_t prg_read(const uint16_t) const;
-  uint8_t chr_read(const uint16_t) const;
+  int     prg_bank(const uint16_t) const;
 
   virtual void prg_write(const uint16_t, const uint8_t);
-  virtual void chr_write(const uint16_t, const uint8_t);
+
+  // Mappers with an IRQ counter schedule event_type::MapperIRQ and get
+  // called back here when it comes due
+  virtual void run_event();
 
   template <auto> void set_prg_map(int, int);
   template <auto> void set_chr_map(int, int);
 
 protected:
   void set_mirroring(const int);
+  void map_prg_ram(const bool);
 
   const nes::cartridge_info& info;
 
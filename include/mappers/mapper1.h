@@ -17,7 +17,6 @@ public:
   void reset() override;
 
   void prg_write(const uint16_t, const uint8_t) override;
-  void chr_write(const uint16_t, const uint8_t) override;
 
 private:
   void apply();
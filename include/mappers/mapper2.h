@@ -17,6 +17,5 @@ public:
   void reset() override;
 
   void prg_write(const uint16_t, const uint8_t) override;
-  void chr_write(const uint16_t, const uint8_t) override;
 };
 }  // namespace nes
\ No newline at end of file
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <string_view>
+
+#include "types.h"
+
+namespace nes {
+
+//
+// Static description of the instruction set, shared by the debugging tools.
+// Mnemonics follow the nestest log, where unofficial opcodes start with '*'
+//
+
+namespace opcodes {
+std::string_view mnemonic(const uint8_t);
+std::string_view mode_name(const addressing_mode::addressing_mode);
+
+addressing_mode::addressing_mode mode(const uint8_t);
+}  // namespace opcodes
+
+}  // namespace nes
@@ -1,12 +1,21 @@
 #pragma once
 
+#include <array>
+#include <bitset>
+#include <vector>
+
 #include "bus.h"
+#include "compositor.h"
+#include "frame.h"
 #include "types.h"
 
 namespace nes {
+class render_thread;
+
 class ppu {
 public:
   void set_bus(nes::bus&);
+  void set_render_thread(nes::render_thread*);
   void power_on();
   void reset();
 
@@ -14,7 +23,189 @@ public:
   void    write(const uint16_t, const uint8_t);
 
   void set_mirroring(const int);
+  void oam_dma(const uint8_t*);
+  void map_chr(const uint16_t, const size_t, const uint8_t*, uint8_t*);
+
+  // The cartridge's CHR in this range of the pattern tables has changed
+  void chr_changed(const uint16_t, const size_t);
+
+  uint64_t sync(const uint64_t);
+  void     end_frame();
+
+private:
+  friend class render_thread;
+
+  nes::bus* bus = nullptr;
+
+  // Frames are drawn by the render thread when there is one, this PPU only
+  // keeps what the CPU sees and logs what it's given for it
+  nes::render_thread* renderer = nullptr;
+  uint64_t            synced   = 0;  // CPU cycle of the last sync
+
+  // The render thread's own PPU: it reads CHR from the thread's copies of
+  // the banks, and keeps the frames it finishes for the thread to pick up
+  bool              replaying       = false;
+  const nes::frame* last_frame      = nullptr;
+  int               frames_finished = 0;
+
+  // Dots run since power on. The PPU runs three dots per CPU cycle
+  uint64_t clock = 0;
+
+  // Position of the next dot to run
+  int  scanline  = 0;
+  int  dot       = 0;
+  bool odd_frame = false;
+
+  uint8_t ctrl     = 0;
+  uint8_t mask     = 0;
+  uint8_t status   = 0;
+  uint8_t oam_addr = 0;
+  uint8_t latch    = 0;  // Last value written, what write-only ports read as
+
+  // Scrolling registers: v, t, x and w
+  uint16_t vram_addr    = 0;
+  uint16_t temp_addr    = 0;
+  uint8_t  fine_x       = 0;
+  bool     write_toggle = false;
+  uint8_t  read_buffer  = 0;
+
+  int mirroring = mirroring::Horizontal;
+
+  // The console's 2 KB of nametable RAM, then the 2 KB that four-screen
+  // cartridges add
+  std::array<uint8_t, 0x1000> vram{};
+
+  // Where each 1 KB nametable slot of $2000-$2FFF is in VRAM, as the
+  // mirroring has it
+  std::array<uint8_t*, 4> nametables = {&vram[0], &vram[0], &vram[0x400],
+                                        &vram[0x400]};
+  std::array<uint8_t, 0x20>  palette{};
+  std::array<uint8_t, 0x100> oam{};
+
+  // The cartridge's CHR in 1 KB banks, as the mapper has it switched in.
+  // Writes go through the second set, nullptr where it's ROM
+  std::array<const uint8_t*, 8> chr_banks{};
+  std::array<uint8_t*, 8>       chr_writes{};
+
+  //
+  // OAM sorted out by line: the first 8 sprites on each in OAM order, and
+  // whether evaluating the line sets the overflow flag. Rebuilt when next
+  // drawn after OAM or the sprite size changes
+  //
+
+  struct sprite_line {
+    uint8_t                count    = 0;
+    bool                   overflow = false;
+    std::array<uint8_t, 8> sprites{};
+  };
+
+  std::array<sprite_line, frame::height> sprite_lines{};
+  bool                                   sprites_valid = false;
+
+  //
+  // Lines are drawn whole at their first dot. Once something a line depends
+  // on changes in the middle of it (registers, CHR banks, mirroring), the
+  // rest of it is drawn dot by dot as the PPU runs, with tile fetches and
+  // scroll increments at the dots the hardware does them
+  //
+
+  std::array<uint8_t, 33 * 8> line_background{};  // Tiles as fetched
+  std::array<uint8_t, 0x100>  line_sprites{};
+
+  bool line_drawn = false;  // Drawn whole with rendering on
+  bool dot_mode   = false;
+  int  line_dot   = 0;  // Next dot the dot path draws
+
+  // What the fetches of the tile in progress have read so far
+  uint8_t fetch_index     = 0;
+  uint8_t fetch_attribute = 0;
+
+  // Dot of the current line at which sprite 0 hits, -1 when it doesn't
+  int sprite0_dot = -1;
+
+  // Where sprite 0 hits next as things are, found without drawing anything
+  // and kept until something it depends on changes. -1 when it doesn't
+  // before the frame ends
+  bool hit_predicted  = false;
+  int  predicted_line = -1;
+  int  predicted_dot  = -1;
+
+  // The finished frame stays untouched while the next one is drawn in the
+  // other, until it is finished in turn
+  std::vector<nes::frame> frames;
+  size_t                  drawing = 0;
+
+  // Merges the layers of a line, the fastest version the host runs
+  const compositor* kernels = nullptr;
+
+  //
+  // Pattern tables decoded to one byte per pixel, eight pixels to a row
+  // with the leftmost in the low byte. Rows 8-15 of a tile hold it
+  // mirrored for sprites flipped horizontally. A tile is decoded when it's
+  // next drawn after its CHR changed
+  //
+
+  std::vector<uint64_t> tile_rows;
+  std::bitset<0x200>    tile_valid;
+
+  //
+  // The background of each 1 KB page of VRAM drawn whole, for lines to be
+  // copied out of at their scroll. A row of tiles is drawn again when next
+  // used after its nametable or attribute bytes change, or the CHR of one of
+  // its tiles does. CHR changes are only looked at as a frame starts, lines
+  // are drawn from VRAM until then, and so are lines using the other
+  // pattern table
+  //
+
+  std::vector<uint8_t> layer;
+  std::bitset<4 * 30>  layer_stale;
+  std::bitset<0x200>   chr_stale;
+  bool                 layer_live  = false;
+  uint8_t              layer_table = 0;  // PPUCTRL bit 4 it was drawn with
+
+  uint64_t pattern_row(const uint16_t, const int, const bool);
+  void     decode_tile(const size_t);
+
+  void           refresh_layer();
+  const uint8_t* layer_line(const uint8_t*, const int, const int);
+  void           render_layer_row(const size_t, const int);
+
+  uint8_t memory_read(uint16_t);
+  void    memory_write(uint16_t, const uint8_t);
+  uint8_t& nametable(const uint16_t);
+  uint8_t palette_offset(const uint16_t) const;
+
+  bool rendering() const;
+  void increment_x();
+  void increment_y();
+  void copy_horizontal();
+  void copy_vertical();
+
+  void     render_line();
+  void     compare_line();
+  uint64_t tile_span(const uint16_t);
+  uint8_t  tile_attribute(const uint16_t);
+  uint64_t tile_row(const uint8_t, const uint8_t, const int);
+  void     render_background();
+  void     render_sprites();
+  void     evaluate_line();
+  uint64_t sprite_row(const uint8_t*, const int);
+  void     evaluate_sprites();
+
+  void predict_hit();
+  int  line_hit(const int);
+
+  void before_change();
+  void render_dots(const int);
+  void render_pixel(const int);
 
   void step();
+  void advance(const int);
+
+  int      event_dot(const int, const int) const;
+  int      dots_until_event() const;
+  int      dots_until(const int, const int) const;
+  int      dots_until_status() const;
+  uint64_t next_event() const;
 };
-}  // namespace nes
\ No newline at end of file
+}  // namespace nes
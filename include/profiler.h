@@ -0,0 +1,78 @@
+#pragma once
+
+#include <array>
+#include <filesystem>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+#include "types.h"
+
+namespace nes {
+
+//
+// Counts where emulated time goes, per opcode, per addressing mode and per
+// instruction within each 8 KB PRG-ROM bank. JSR, BRK and interrupts open a
+// call frame that closes once the stack pointer climbs back above it, which
+// also copes with code that jumps through pushed addresses
+//
+
+class profiler {
+public:
+  profiler();
+
+  void clear();
+
+  void instruction(const uint16_t, const int, const uint8_t, const uint64_t);
+  void interrupt(const uint16_t, const int, const uint8_t, const uint64_t);
+  void call(const uint16_t, const int, const uint8_t);
+  void unwind(const uint8_t);
+
+  // Writes <path>.csv and <path>.folded, the latter for flamegraph.pl
+  void dump(const std::filesystem::path&) const;
+
+  void write_csv(std::ostream&) const;
+  void write_folded(std::ostream&) const;
+
+private:
+  struct counter {
+    uint64_t count  = 0;
+    uint64_t cycles = 0;
+  };
+
+  // RAM code is keyed by its address, PRG-ROM code by its offset in the
+  // ROM plus 0x8000, so every bank gets its own entries
+  struct site {
+    uint64_t count  = 0;
+    uint64_t cycles = 0;
+    uint16_t pc     = 0;
+    uint8_t  opcode = 0;
+  };
+
+  struct frame_node {
+    size_t   parent = 0;
+    int      bank   = -1;
+    uint16_t pc     = 0;
+    uint64_t cycles = 0;  // Spent in the function itself
+  };
+
+  static constexpr size_t max_depth = 64;
+
+  struct frame {
+    size_t  node = 0;
+    uint8_t sp   = 0;  // Stack pointer before the return address went in
+  };
+
+  std::array<counter, 0x100> by_opcode;
+  counter                    interrupts;
+  std::vector<site>          sites;
+
+  std::vector<frame_node>              nodes;  // nodes[0] is the root
+  std::unordered_map<uint64_t, size_t> children;
+  std::vector<frame>                   stack;
+  size_t                               current = 0;
+
+  void write_path(std::ostream&, const size_t) const;
+};
+
+}  // namespace nes
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <array>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "frame.h"
+#include "ppu.h"
+#include "types.h"
+
+namespace nes {
+
+//
+// Draws the frames on a thread of its own, one frame behind. The PPU the CPU
+// talks to keeps everything the CPU can see up to date without drawing, and
+// logs what it's given stamped with the CPU cycle it came at. At the end of
+// each frame the log goes to the worker, which runs it through a PPU of its
+// own while the CPU goes on with the next one. Set it on the PPU before the
+// cartridge is loaded, so the log starts from the same state
+//
+
+namespace ppu_input {
+enum ppu_input { Read, Write, OAM_DMA, Mirroring, CHR_Bank, PowerOn, Reset };
+}
+
+struct ppu_log {
+  struct entry {
+    uint64_t             cycle = 0;
+    ppu_input::ppu_input type  = ppu_input::Read;
+    uint16_t             addr  = 0;
+    int                  value = 0;  // Also the bank, for CHR
+    size_t               data  = 0;  // Where its bytes start, for OAM and CHR
+    bool                 ram   = false;  // Whether the CHR bank is writable
+  };
+
+  std::vector<entry>   entries;
+  std::vector<uint8_t> bytes;
+  uint64_t             end = 0;  // CPU cycle the frame was run up to
+};
+
+class render_thread {
+public:
+  render_thread();
+  ~render_thread();
+
+  render_thread(const render_thread&)            = delete;
+  render_thread& operator=(const render_thread&) = delete;
+
+  void record(const uint64_t, const ppu_input::ppu_input, const uint16_t = 0,
+              const int = 0);
+  void record(const uint64_t, const ppu_input::ppu_input, const uint16_t,
+              const uint8_t*, const size_t);
+  void record_bank(const uint64_t, const uint16_t, const uint8_t*,
+                   const bool);
+
+  // Hands the log of the frame just run to the worker, once it's done with
+  // the one before. Returns how many frames that one finished, the last of
+  // them in output()
+  int submit(const uint64_t);
+
+  const nes::frame& output() const;
+
+private:
+  nes::ppu   replica;
+  nes::frame finished;
+
+  //
+  // CHR banks are told apart by where they are in host memory, and numbered
+  // in the order they're first switched in. Only then do their bytes go in
+  // the log, the worker keeps one copy of each from there on, whichever
+  // slots show it, and CHR RAM writes keep it up to date
+  //
+
+  std::unordered_map<const uint8_t*, int> banks;        // The CPU thread's
+  std::deque<std::array<uint8_t, 0x400>>  bank_copies;  // The worker's
+
+  std::array<ppu_log, 2> logs;
+  size_t                 recording = 0;  // The other one is the worker's
+
+  std::mutex              mutex;
+  std::condition_variable wake;
+  std::condition_variable idle;
+  bool                    busy = false;
+  bool                    stop = false;
+  std::thread             worker;
+
+  void work();
+  void replay(const ppu_log&);
+  void switch_bank(const ppu_log&, const ppu_log::entry&);
+};
+}  // namespace nes
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <array>
+#include <limits>
+
+#include "types.h"
+
+namespace nes {
+
+//
+// Deadlines in CPU cycles, one slot per event type, kept in an indexed
+// min-heap so the earliest one is always at hand and any of them can be
+// moved or cancelled in place
+//
+
+class scheduler {
+public:
+  static constexpr uint64_t never = std::numeric_limits<uint64_t>::max();
+
+  scheduler();
+
+  void schedule(const event_type::event_type, const uint64_t);
+  void cancel(const event_type::event_type);
+
+  uint64_t deadline(const event_type::event_type) const;
+
+  uint64_t               next() const;  // Earliest deadline
+  event_type::event_type top() const;   // Event with the earliest deadline
+
+private:
+  static constexpr size_t count = event_type::Count;
+  static constexpr size_t none  = count;  // Position of unscheduled events
+
+  std::array<uint64_t, count>               deadlines;
+  std::array<size_t, count>                 position;
+  std::array<event_type::event_type, count> heap;
+  size_t                                    size = 0;
+
+  bool before(const size_t, const size_t) const;
+  void swap(const size_t, const size_t);
+  void sift_up(size_t);
+  void sift_down(size_t);
+};
+
+}  // namespace nes
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+#include "types.h"
+
+namespace nes {
+
+//
+// Flight recorder. The CPU drops one record per instruction into a fixed
+// ring, the state before the instruction runs, and the last records can be
+// written out at any time or from a crash handler. Files hold the records
+// as they are in memory, so they are read back on the same kind of host
+//
+
+struct trace_record {
+  uint64_t cycle   = 0;
+  uint16_t pc      = 0;
+  uint16_t address = 0;  // Effective address, when the mode has one
+  uint8_t  opcode  = 0;
+  uint8_t  operand[2]{};
+  uint8_t  a = 0, x = 0, y = 0, p = 0, sp = 0;
+  uint8_t  value = 0;  // What address held before the instruction
+};
+
+class trace_ring {
+public:
+  explicit trace_ring(const size_t = 0x10000);  // Rounded up to a power of 2
+
+  // Single writer. Readers may run on another thread or in a signal
+  // handler, they can only lose the oldest records to the writer
+  void push(const trace_record& record)
+  {
+    const auto index      = head.load(std::memory_order_relaxed);
+    records[index & mask] = record;
+    head.store(index + 1, std::memory_order_release);
+  }
+
+  size_t capacity() const;
+  void   clear();
+
+  // Records pushed since the last clear, and one of them by that count.
+  // Only the last capacity() are still there, and only the writer's
+  // thread can read them this way without racing it
+  uint64_t            written() const;
+  const trace_record& at(const uint64_t) const;
+
+  std::vector<trace_record> snapshot() const;  // Oldest first
+
+  void dump(const std::filesystem::path&) const;
+  void dump_on_crash(const std::filesystem::path&);
+  void write(std::FILE*) const;
+
+private:
+  std::unique_ptr<trace_record[]> records;
+  size_t                          mask = 0;
+  std::atomic<uint64_t>           head = 0;
+};
+
+std::vector<trace_record> read_trace(const std::filesystem::path&);
+
+// One line in the format of the nestest log, CYC being the PPU dot
+void write_nestest(std::ostream&, const trace_record&);
+int  nestest_dot(const trace_record&);
+
+}  // namespace nes
@@ -7,6 +7,7 @@ using std::int8_t;
 using std::size_t;
 using std::uint16_t;
 using std::uint32_t;
+using std::uint64_t;
 using std::uint8_t;
 using std::uintmax_t;
 
@@ -40,6 +41,18 @@ namespace interruption_type {
 enum interruption_type { NMI, RST, IRQ, BRK };
 }
 
+// How closely the CPU follows the bus. Cycle ticks on every access, so the
+// rest of the system sees each read and write at its exact cycle.
+// Instruction charges whole instructions up front from a table
+namespace accuracy {
+enum accuracy { Cycle, Instruction };
+}
+
+// Timed events, in the order they are handled when they fall on one cycle
+namespace event_type {
+enum event_type { FrameEnd, PPU, APU_Frame, APU_DMC, MapperIRQ, Count };
+}
+
 namespace addressing_mode {
 enum addressing_mode {
   Implicit,
@@ -83,23 +96,46 @@ struct state {
   uint8_t  sp = 0;
   uint8_t  sr = 0;
 
-  uint8_t ps = 0;
+  // Every flag but N and Z. Those are only derived from the last result
+  // that set them when somebody asks for the status register
+  uint8_t p        = 0;
+  uint8_t n_result = 0;
+  uint8_t z_result = 1;
 
   bool nmi_flag = false;
   bool irq_flag = false;
 
-  int cycle_count = 0;
+  uint64_t cycle_count = 0;
+
+  // Branches and the IRQ check test flags all the time. Only N and Z have to
+  // be looked for in the results they come from
+  bool check_flags(const uint8_t mask) const
+  {
+    uint8_t value = this->p & mask;
+
+    if (mask & flags::Negative) {
+      value |= this->n_result & flags::Negative;
+    }
+
+    if ((mask & flags::Zero) && !this->z_result) {
+      value |= flags::Zero;
+    }
+
+    return value == mask;
+  }
 
-  bool check_flags(const uint8_t) const;
   void set_flags(const uint8_t);
   void clear_flags(const uint8_t);
   void update_nz(const uint8_t);
+  void update_nz(const uint8_t, const uint8_t);
 
   void set_a(const uint8_t);
   void set_x(const uint8_t);
   void set_y(const uint8_t);
   void set_pc(const uint16_t);
   void set_ps(const uint8_t);
+
+  uint8_t ps() const;
 };
 
 //
@@ -141,7 +177,14 @@ template <auto Operation> int get_ppu_map(const uint16_t);
 //
 
 namespace mirroring {
-enum mirroring { Unset = -1, Horizontal, Vertical };
+enum mirroring {
+  Unset = -1,
+  Horizontal,
+  Vertical,
+  SingleLower,
+  SingleUpper,
+  FourScreen
+};
 }
 
 struct cartridge_info {
@@ -1,19 +1,720 @@
 #include "apu.h"
 
+#include <algorithm>
+
 namespace nes {
+namespace {
+constexpr double clock_rate   = 1789773;
+constexpr int    frame_cycles = 29781;
+
+constexpr std::array<uint8_t, 32> lengths = {
+    10, 254, 20, 2,  40, 4,  80, 6,  160, 8,  60, 10, 14, 12, 26, 14,
+    12, 16,  24, 18, 48, 20, 96, 22, 192, 24, 72, 26, 16, 28, 32, 30};
+
+constexpr std::array<std::array<uint8_t, 8>, 4> duties = {{
+    {0, 1, 0, 0, 0, 0, 0, 0},
+    {0, 1, 1, 0, 0, 0, 0, 0},
+    {0, 1, 1, 1, 1, 0, 0, 0},
+    {1, 0, 0, 1, 1, 1, 1, 1},
+}};
+
+constexpr std::array<uint8_t, 32> triangle_steps = {
+    15, 14, 13, 12, 11, 10, 9,  8,  7,  6,  5,  4,  3,  2,  1,  0,
+    0,  1,  2,  3,  4,  5,  6,  7,  8,  9,  10, 11, 12, 13, 14, 15};
+
+constexpr std::array<uint16_t, 16> noise_periods = {
+    4,   8,   16,  32,  64,  96,  128,  160,
+    202, 254, 380, 508, 762, 1016, 2034, 4068};
+
+constexpr std::array<uint16_t, 16> dmc_periods = {
+    428, 380, 340, 320, 286, 254, 226, 214,
+    190, 160, 142, 128, 106, 84,  72,  54};
+
+//
+// Frame counter sequences, in CPU cycles from the start of each
+//
+
+namespace frame_clock {
+enum frame_clock : uint8_t { Quarter = 0x01, Half = 0x02, IRQ = 0x04 };
+}
+
+struct frame_step {
+  int     cycle;
+  uint8_t clocks;
+};
+
+using namespace frame_clock;
+
+constexpr std::array<frame_step, 6> four_steps = {{
+    {7457, Quarter},
+    {14913, Quarter | Half},
+    {22371, Quarter},
+    {29828, IRQ},
+    {29829, Quarter | Half | IRQ},
+    {29830, IRQ},
+}};
+
+constexpr std::array<frame_step, 4> five_steps = {{
+    {7457, Quarter},
+    {14913, Quarter | Half},
+    {22371, Quarter},
+    {37281, Quarter | Half},
+}};
+
+constexpr int four_period = 29830;
+constexpr int five_period = 37282;
+
+//
+// The mixer's nonlinear sums, scaled to the levels put in the blip buffer
+//
+
+constexpr double volume = 30000;
+
+constexpr auto pulse_levels = [] {
+  std::array<int, 31> table{};
+
+  for (size_t n = 1; n < table.size(); ++n) {
+    table[n] = static_cast<int>(volume * 95.52 / (8128.0 / n + 100) + 0.5);
+  }
+
+  return table;
+}();
+
+constexpr auto tnd_levels = [] {
+  std::array<int, 203> table{};
+
+  for (size_t n = 1; n < table.size(); ++n) {
+    table[n] = static_cast<int>(volume * 163.67 / (24329.0 / n + 100) + 0.5);
+  }
+
+  return table;
+}();
+}  // namespace
+
+apu::apu() : blip(clock_rate, sample_rate, frame_cycles) {}
+
 void apu::set_bus(nes::bus& ref)
 {
   this->bus = &ref;
 }
 
-void apu::power_on() {}
+void apu::set_output(nes::audio_ring* value)
+{
+  audio = value;
+}
+
+void apu::power_on()
+{
+  pulses   = {};
+  triangle = {};
+  noise    = {};
+  dmc      = {};
+
+  pulses[0].sweep_carry = 1;
+
+  noise.period = noise_periods[0];
+  dmc.period   = dmc_periods[0];
+  dmc.next     = dmc.period;
+
+  five_step   = false;
+  irq_inhibit = false;
+  frame_irq   = false;
+  dmc_irq     = false;
+  frame_start = 0;
+  frame_index = 0;
+  frame_next  = four_steps[0].cycle;
+
+  time = 0;
+  base = this->bus->cpu_cycles();
+
+  blip      = nes::blip_buffer{clock_rate, sample_rate, frame_cycles};
+  amplitude = 0;
+  output.clear();
+
+  this->schedule_frame_irq();
+}
+
+// Only $4015 can be read
+uint8_t apu::read(const int elapsed)
+{
+  base = this->bus->cpu_cycles() - elapsed;
+  this->run_to(elapsed);
+
+  const uint8_t value = (pulses[0].length ? 0x01 : 0) |
+                        (pulses[1].length ? 0x02 : 0) |
+                        (triangle.length ? 0x04 : 0) |
+                        (noise.length ? 0x08 : 0) |
+                        (dmc.remaining ? 0x10 : 0) | (frame_irq ? 0x40 : 0) |
+                        (dmc_irq ? 0x80 : 0);
+
+  frame_irq = false;
+  this->update_irq();
+  this->schedule_frame_irq();
+
+  return value;
+}
+
+void apu::write(const int elapsed, const uint16_t addr, const uint8_t value)
+{
+  base = this->bus->cpu_cycles() - elapsed;
+  this->run_to(elapsed);
+
+  switch (addr) {
+    case 0x4000:
+    case 0x4001:
+    case 0x4002:
+    case 0x4003: this->write_pulse(pulses[0], addr & 3, value); break;
+    case 0x4004:
+    case 0x4005:
+    case 0x4006:
+    case 0x4007: this->write_pulse(pulses[1], addr & 3, value); break;
+    case 0x4008:
+      triangle.control       = value & 0x80;
+      triangle.linear_period = value & 0x7F;
+      break;
+    case 0x400A:
+      triangle.period = (triangle.period & 0x700) | value;
+      this->arm_triangle();
+      break;
+    case 0x400B:
+      triangle.period = (triangle.period & 0xFF) | ((value & 7) << 8);
+      triangle.reload = true;
+
+      if (triangle.enabled) {
+        triangle.length = lengths[value >> 3];
+      }
+
+      this->arm_triangle();
+      break;
+    case 0x400C:
+      noise.envelope.loop     = value & 0x20;
+      noise.envelope.constant = value & 0x10;
+      noise.envelope.period   = value & 0x0F;
+      break;
+    case 0x400E:
+      noise.mode   = value & 0x80;
+      noise.period = noise_periods[value & 0x0F];
+      break;
+    case 0x400F:
+      if (noise.enabled) {
+        noise.length = lengths[value >> 3];
+      }
+
+      noise.envelope.start = true;
+      this->arm_noise();
+      break;
+    case 0x4010:
+      dmc.irq_enabled = value & 0x80;
+      dmc.loop        = value & 0x40;
+      dmc.period      = dmc_periods[value & 0x0F];
+
+      if (!dmc.irq_enabled) {
+        dmc_irq = false;
+        this->update_irq();
+      }
+
+      this->schedule_dmc_irq();
+      break;
+    case 0x4011: dmc.level = value & 0x7F; break;
+    case 0x4012: dmc.sample_addr = 0xC000 | (value << 6); break;
+    case 0x4013: dmc.sample_length = (value << 4) | 1; break;
+    case 0x4015:
+      pulses[0].enabled = value & 0x01;
+      pulses[1].enabled = value & 0x02;
+      triangle.enabled  = value & 0x04;
+      noise.enabled     = value & 0x08;
+
+      for (auto& pulse : pulses) {
+        if (!pulse.enabled) {
+          pulse.length = 0;
+        }
+      }
+
+      if (!triangle.enabled) {
+        triangle.length = 0;
+      }
+
+      if (!noise.enabled) {
+        noise.length = 0;
+      }
+
+      // The DMC starts its sample over only when it had finished it
+      if (!(value & 0x10)) {
+        dmc.remaining = 0;
+      } else if (!dmc.remaining) {
+        dmc.addr      = dmc.sample_addr;
+        dmc.remaining = dmc.sample_length;
+        this->fetch_sample();
+      }
+
+      dmc_irq = false;
+      this->update_irq();
+      this->schedule_dmc_irq();
+      break;
+    case 0x4017: this->set_frame_counter(value); break;
+    default: break;
+  }
+
+  this->mix(elapsed);
+}
+
+// The channels run up to the end of the frame, and its samples are taken
+// out of the blip buffer and handed on. Times count from the next frame's
+// start after
+void apu::run_frame(const int length)
+{
+  this->run_to(length);
+  blip.end_frame(length);
+
+  output.clear();
+  blip.read_samples(output);
+
+  if (audio) {
+    audio->push(output.data(), output.size());
+  }
+
+  const auto rebase = [length](int& cycle) {
+    if (cycle != never) {
+      cycle -= length;
+    }
+  };
+
+  rebase(time);
+  rebase(frame_start);
+  rebase(frame_next);
+  rebase(pulses[0].next);
+  rebase(pulses[1].next);
+  rebase(triangle.next);
+  rebase(noise.next);
+  rebase(dmc.next);
+
+  base += length;
+}
+
+// An IRQ is due, the channels catch up to now so its flag gets set
+void apu::run_event(const event_type::event_type event)
+{
+  this->run_to(static_cast<int>(this->bus->cpu_cycles() - base));
+
+  if (event == event_type::APU_Frame) {
+    this->schedule_frame_irq();
+  } else {
+    this->schedule_dmc_irq();
+  }
+}
+
+const std::vector<int16_t>& apu::samples() const
+{
+  return output;
+}
+
+//
+// Catching up
+//
+
+// Runs the timer clocks and frame counter steps up to the given cycle, the
+// earliest first
+void apu::run_to(const int end)
+{
+  while (true) {
+    const int next = std::min({frame_next, pulses[0].next, pulses[1].next,
+                               triangle.next, noise.next, dmc.next});
+
+    if (next > end) {
+      break;
+    }
+
+    time = next;
+
+    if (next == frame_next) {
+      this->clock_frame(next);
+    } else if (next == pulses[0].next) {
+      this->clock_pulse(pulses[0], next);
+    } else if (next == pulses[1].next) {
+      this->clock_pulse(pulses[1], next);
+    } else if (next == triangle.next) {
+      this->clock_triangle(next);
+    } else if (next == noise.next) {
+      this->clock_noise(next);
+    } else {
+      this->clock_dmc(next);
+    }
+  }
+
+  time = std::max(time, end);
+}
+
+// The output as the channels have it now goes in from the given cycle on
+void apu::mix(const int cycle)
+{
+  const int pulse = pulses[0].output() + pulses[1].output();
+  const int tnd   = 3 * triangle_steps[triangle.step] + 2 * noise.output() +
+                  dmc.level;
+  const int level = pulse_levels[pulse] + tnd_levels[tnd];
+
+  if (level != amplitude) {
+    blip.add_delta(cycle, level - amplitude);
+    amplitude = level;
+  }
+}
+
+//
+// Frame counter
+//
+
+void apu::clock_frame(const int cycle)
+{
+  const frame_step& step =
+      five_step ? five_steps[frame_index] : four_steps[frame_index];
+  const size_t count = five_step ? five_steps.size() : four_steps.size();
+
+  if (step.clocks & Quarter) {
+    this->quarter_frame();
+  }
+
+  if (step.clocks & Half) {
+    this->half_frame();
+  }
+
+  if ((step.clocks & IRQ) && !irq_inhibit) {
+    frame_irq = true;
+    this->update_irq();
+  }
+
+  if (++frame_index == count) {
+    frame_index = 0;
+    frame_start += five_step ? five_period : four_period;
+  }
+
+  frame_next = frame_start + (five_step ? five_steps[frame_index].cycle
+                                        : four_steps[frame_index].cycle);
+  this->mix(cycle);
+}
+
+// Envelopes and the triangle's linear counter
+void apu::quarter_frame()
+{
+  pulses[0].envelope.clock();
+  pulses[1].envelope.clock();
+  noise.envelope.clock();
+
+  if (triangle.reload) {
+    triangle.linear = triangle.linear_period;
+  } else if (triangle.linear) {
+    --triangle.linear;
+  }
+
+  if (!triangle.control) {
+    triangle.reload = false;
+  }
+
+  this->arm_triangle();
+}
+
+// Length counters and sweeps
+void apu::half_frame()
+{
+  for (auto& pulse : pulses) {
+    if (pulse.length && !pulse.envelope.loop) {
+      --pulse.length;
+    }
+
+    if (!pulse.sweep_divider && pulse.sweep_enabled && pulse.sweep_shift &&
+        !pulse.muted()) {
+      pulse.period = static_cast<uint16_t>(pulse.sweep_target());
+      this->arm_pulse(pulse);
+    }
+
+    if (!pulse.sweep_divider || pulse.sweep_reload) {
+      pulse.sweep_divider = pulse.sweep_period;
+      pulse.sweep_reload  = false;
+    } else {
+      --pulse.sweep_divider;
+    }
+  }
+
+  if (triangle.length && !triangle.control) {
+    --triangle.length;
+  }
+
+  if (noise.length && !noise.envelope.loop) {
+    --noise.length;
+  }
+}
+
+// The sequence starts over 3 or 4 cycles after the write, the 5-step one
+// clocking everything at once
+void apu::set_frame_counter(const uint8_t value)
+{
+  five_step   = value & 0x80;
+  irq_inhibit = value & 0x40;
+
+  if (irq_inhibit) {
+    frame_irq = false;
+    this->update_irq();
+  }
+
+  frame_start = time + (((base + time) & 1) ? 4 : 3);
+  frame_index = 0;
+  frame_next  = frame_start + four_steps[0].cycle;
+
+  if (five_step) {
+    this->quarter_frame();
+    this->half_frame();
+  }
+
+  this->schedule_frame_irq();
+}
+
+//
+// Channels
+//
+
+void apu::envelope_unit::clock()
+{
+  if (start) {
+    start   = false;
+    decay   = 15;
+    divider = period;
+  } else if (divider) {
+    --divider;
+  } else {
+    divider = period;
+
+    if (decay) {
+      --decay;
+    } else if (loop) {
+      decay = 15;
+    }
+  }
+}
+
+uint8_t apu::envelope_unit::volume() const
+{
+  return constant ? period : decay;
+}
+
+int apu::pulse_channel::sweep_target() const
+{
+  const int change = period >> sweep_shift;
+  return sweep_negate ? period - change - sweep_carry : period + change;
+}
 
-uint8_t apu::read(const int)
+bool apu::pulse_channel::muted() const
 {
-  return 0;
+  return period < 8 || this->sweep_target() > 0x7FF;
 }
 
-void apu::write(const int, const uint16_t, const uint8_t) {}
+uint8_t apu::pulse_channel::output() const
+{
+  if (!length || this->muted() || !duties[duty][step]) {
+    return 0;
+  }
+
+  return envelope.volume();
+}
 
-void apu::run_frame(int) {}
-}  // namespace nes
\ No newline at end of file
+uint8_t apu::noise_channel::output() const
+{
+  return (shift & 1) || !length ? 0 : envelope.volume();
+}
+
+void apu::write_pulse(pulse_channel& pulse, const uint16_t reg,
+                      const uint8_t value)
+{
+  switch (reg) {
+    case 0:
+      pulse.duty              = value >> 6;
+      pulse.envelope.loop     = value & 0x20;
+      pulse.envelope.constant = value & 0x10;
+      pulse.envelope.period   = value & 0x0F;
+      break;
+    case 1:
+      pulse.sweep_enabled = value & 0x80;
+      pulse.sweep_period  = (value >> 4) & 7;
+      pulse.sweep_negate  = value & 0x08;
+      pulse.sweep_shift   = value & 7;
+      pulse.sweep_reload  = true;
+      break;
+    case 2:
+      pulse.period = (pulse.period & 0x700) | value;
+      this->arm_pulse(pulse);
+      break;
+    case 3:
+      pulse.period = (pulse.period & 0xFF) | ((value & 7) << 8);
+      pulse.step   = 0;
+
+      if (pulse.enabled) {
+        pulse.length = lengths[value >> 3];
+      }
+
+      pulse.envelope.start = true;
+      this->arm_pulse(pulse);
+      break;
+  }
+}
+
+//
+// Timers of channels that can't be heard are stopped, and started again
+// from where the channel is next given a length or period. Pulses below
+// period 8 are silent, and the triangle holds its output when halted or at
+// the ultrasonic periods games silence it with
+//
+
+void apu::arm_pulse(pulse_channel& pulse)
+{
+  if (pulse.period < 8 || !pulse.length) {
+    pulse.next = never;
+  } else if (pulse.next == never) {
+    pulse.next = time + (pulse.period + 1) * 2;
+  }
+}
+
+void apu::arm_triangle()
+{
+  if (triangle.period < 2 || !triangle.linear || !triangle.length) {
+    triangle.next = never;
+  } else if (triangle.next == never) {
+    triangle.next = time + triangle.period + 1;
+  }
+}
+
+void apu::arm_noise()
+{
+  if (!noise.length) {
+    noise.next = never;
+  } else if (noise.next == never) {
+    noise.next = time + noise.period;
+  }
+}
+
+void apu::clock_pulse(pulse_channel& pulse, const int cycle)
+{
+  pulse.next = cycle + (pulse.period + 1) * 2;
+  pulse.step = (pulse.step + 1) & 7;
+  this->mix(cycle);
+  this->arm_pulse(pulse);
+}
+
+void apu::clock_triangle(const int cycle)
+{
+  triangle.next = cycle + triangle.period + 1;
+  triangle.step = (triangle.step + 1) & 31;
+  this->mix(cycle);
+  this->arm_triangle();
+}
+
+void apu::clock_noise(const int cycle)
+{
+  const int tap      = noise.mode ? 6 : 1;
+  const int feedback = (noise.shift ^ (noise.shift >> tap)) & 1;
+
+  noise.next  = cycle + noise.period;
+  noise.shift = (noise.shift >> 1) | (feedback << 14);
+  this->mix(cycle);
+  this->arm_noise();
+}
+
+// One bit of the shift register moves the level up or down by 2. Every 8
+// the next byte is taken from the buffer, which fetches another
+void apu::clock_dmc(const int cycle)
+{
+  dmc.next = cycle + dmc.period;
+
+  if (!dmc.silent) {
+    if (dmc.shift & 1) {
+      if (dmc.level <= 125) {
+        dmc.level += 2;
+      }
+    } else if (dmc.level >= 2) {
+      dmc.level -= 2;
+    }
+
+    this->mix(cycle);
+  }
+
+  dmc.shift >>= 1;
+
+  if (--dmc.bits == 0) {
+    dmc.bits   = 8;
+    dmc.silent = !dmc.buffer_full;
+
+    if (dmc.buffer_full) {
+      dmc.shift       = dmc.buffer;
+      dmc.buffer_full = false;
+      this->fetch_sample();
+    }
+  }
+}
+
+// Samples are read from the cartridge as they're needed. The CPU isn't
+// stalled for it
+void apu::fetch_sample()
+{
+  if (dmc.buffer_full || !dmc.remaining) {
+    return;
+  }
+
+  dmc.buffer      = this->bus->prg_read(dmc.addr);
+  dmc.buffer_full = true;
+  dmc.addr        = dmc.addr == 0xFFFF ? 0x8000 : dmc.addr + 1;
+
+  if (--dmc.remaining) {
+    return;
+  }
+
+  if (dmc.loop) {
+    dmc.addr      = dmc.sample_addr;
+    dmc.remaining = dmc.sample_length;
+  } else if (dmc.irq_enabled) {
+    dmc_irq = true;
+    this->update_irq();
+  }
+}
+
+//
+// IRQs. Both flags drive the CPU's line, and each is scheduled for the cycle
+// it'll be set at so the CPU sees it on time without the APU running
+//
+
+void apu::update_irq()
+{
+  this->bus->set_irq(frame_irq || dmc_irq);
+}
+
+void apu::schedule_frame_irq()
+{
+  if (five_step || irq_inhibit || frame_irq) {
+    this->bus->cancel(event_type::APU_Frame);
+    return;
+  }
+
+  size_t index = frame_index;
+  int    start = frame_start;
+
+  while (!(four_steps[index].clocks & IRQ)) {
+    if (++index == four_steps.size()) {
+      index = 0;
+      start += four_period;
+    }
+  }
+
+  this->bus->schedule(event_type::APU_Frame,
+                      base + start + four_steps[index].cycle);
+}
+
+// The buffer stays full while bytes remain. The next is fetched as the
+// output unit takes it at the start of its next cycle, then one every cycle
+void apu::schedule_dmc_irq()
+{
+  if (!dmc.irq_enabled || dmc.loop || !dmc.remaining || dmc_irq) {
+    this->bus->cancel(event_type::APU_DMC);
+    return;
+  }
+
+  const int start = dmc.next + (dmc.bits - 1) * dmc.period;
+  const int last  = start + (dmc.remaining - 1) * 8 * dmc.period;
+
+  this->bus->schedule(event_type::APU_DMC, base + last);
+}
+}  // namespace nes
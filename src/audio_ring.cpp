@@ -0,0 +1,86 @@
+#include "audio_ring.h"
+
+#include <algorithm>
+
+namespace nes {
+audio_ring::audio_ring(const size_t size)
+{
+  size_t capacity = 1;
+
+  while (capacity < size) {
+    capacity <<= 1;
+  }
+
+  samples = std::make_unique<int16_t[]>(capacity);
+  mask    = capacity - 1;
+}
+
+size_t audio_ring::push(const int16_t* data, const size_t count)
+{
+  const size_t start = head.load(std::memory_order_relaxed);
+  const size_t end   = tail.load(std::memory_order_acquire);
+  const size_t room  = this->capacity() - (start - end);
+  const size_t n     = std::min(count, room);
+
+  for (size_t i = 0; i < n; ++i) {
+    samples[(start + i) & mask] = data[i];
+  }
+
+  head.store(start + n, std::memory_order_release);
+
+  if (n < count) {
+    dropped.store(dropped.load(std::memory_order_relaxed) + count - n,
+                  std::memory_order_relaxed);
+  }
+
+  return n;
+}
+
+size_t audio_ring::pop(int16_t* out, const size_t count)
+{
+  const size_t start = tail.load(std::memory_order_relaxed);
+  const size_t end   = head.load(std::memory_order_acquire);
+  const size_t n     = std::min(count, end - start);
+
+  for (size_t i = 0; i < n; ++i) {
+    out[i] = samples[(start + i) & mask];
+  }
+
+  tail.store(start + n, std::memory_order_release);
+
+  if (n > 0) {
+    last = out[n - 1];
+  }
+
+  if (n < count) {
+    std::fill(out + n, out + count, last);
+    missing.store(missing.load(std::memory_order_relaxed) + count - n,
+                  std::memory_order_relaxed);
+  }
+
+  return n;
+}
+
+size_t audio_ring::capacity() const
+{
+  return mask + 1;
+}
+
+// Only exact on either side's thread, anywhere else it may be off by what
+// the other is doing. The tail is read first, it can't pass the head
+size_t audio_ring::size() const
+{
+  const size_t end = tail.load(std::memory_order_acquire);
+  return head.load(std::memory_order_acquire) - end;
+}
+
+uint64_t audio_ring::overruns() const
+{
+  return dropped.load(std::memory_order_relaxed);
+}
+
+uint64_t audio_ring::underruns() const
+{
+  return missing.load(std::memory_order_relaxed);
+}
+}  // namespace nes
@@ -0,0 +1,104 @@
+#include "blip_buffer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace nes {
+blip_buffer::blip_buffer(
+    const double clock_rate,
+    const int    sample_rate,
+    const int    frame_clocks)
+    : factor(static_cast<uint64_t>(std::llround(sample_rate / clock_rate *
+                                                4294967296.0))),
+      steps(make_steps())
+{
+  // Two frames of room, deltas can land a little past the end of one
+  const auto frame_samples = (uint64_t{1} * frame_clocks * factor) >> 32;
+  deltas.assign(frame_samples * 2 + taps, 0);
+}
+
+void blip_buffer::add_delta(const int clock, const int delta)
+{
+  const uint64_t position = offset + static_cast<uint64_t>(clock) * factor;
+  const size_t   index    = position >> 32;
+  const size_t   phase    = (position >> (32 - phase_bits)) & (phases - 1);
+  const auto&    step     = steps[phase];
+
+  if (index + taps > deltas.size()) {
+    throw std::runtime_error("Audio delta past the end of the buffer");
+  }
+
+  for (int i = 0; i < taps; ++i) {
+    deltas[index + i] += step[i] * delta;
+  }
+}
+
+void blip_buffer::end_frame(const int clocks)
+{
+  offset += static_cast<uint64_t>(clocks) * factor;
+}
+
+void blip_buffer::read_samples(std::vector<int16_t>& out)
+{
+  const size_t count = offset >> 32;
+
+  for (size_t i = 0; i < count; ++i) {
+    integrator += deltas[i];
+
+    const int32_t sample = integrator >> kernel_bits;
+    integrator -= sample * (1 << (kernel_bits - bass_shift));
+
+    out.push_back(static_cast<int16_t>(std::clamp(sample, -32768, 32767)));
+  }
+
+  // What's past the samples read is the start of the next ones
+  std::copy(deltas.begin() + count, deltas.end(), deltas.begin());
+  std::fill(deltas.end() - count, deltas.end(), 0);
+  offset -= uint64_t{count} << 32;
+}
+
+// A step spread over the taps as a Blackman-windowed sinc, cut off a little
+// under the Nyquist frequency, for each fraction of a sample it can start
+// at. Each phase sums to exactly one so the steps leave no error behind
+blip_buffer::kernel blip_buffer::make_steps()
+{
+  constexpr double pi     = 3.14159265358979323846;
+  constexpr double cutoff = 0.9;
+  constexpr double half   = taps / 2;
+
+  kernel result{};
+
+  for (int phase = 0; phase < phases; ++phase) {
+    std::array<double, taps> impulse{};
+    double                   sum = 0;
+
+    for (int i = 0; i < taps; ++i) {
+      const double x      = i - (half - 1) - (phase + 0.5) / phases;
+      const double window = 0.42 + 0.5 * std::cos(pi * x / half) +
+                            0.08 * std::cos(2 * pi * x / half);
+      const double sinc   = std::sin(pi * cutoff * x) / (pi * cutoff * x);
+
+      impulse[i] = sinc * window;
+      sum += impulse[i];
+    }
+
+    int32_t total   = 0;
+    int     largest = 0;
+
+    for (int i = 0; i < taps; ++i) {
+      result[phase][i] = static_cast<int32_t>(
+          std::lround(impulse[i] / sum * (1 << kernel_bits)));
+      total += result[phase][i];
+
+      if (result[phase][i] > result[phase][largest]) {
+        largest = i;
+      }
+    }
+
+    result[phase][largest] += (1 << kernel_bits) - total;
+  }
+
+  return result;
+}
+}  // namespace nes
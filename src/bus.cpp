@@ -52,6 +52,33 @@ void bus::set_component(nes::emulator& ref)
 void bus::run_frame()
 {
   this->cpu->run_frame();
+
+  // The trace of the frame is checked against the reference log, if any
+  if (this->debugger) {
+    this->debugger->check();
+  }
+
+  this->apu->run_frame(this->cpu->frame_cycles());
+  this->ppu->end_frame();
+}
+
+uint64_t bus::cpu_cycles() const
+{
+  return this->cpu->cycles();
+}
+
+void bus::dump_trace(const std::filesystem::path& path) const
+{
+  this->cpu->dump_trace(path);
+}
+
+void bus::map_cpu_memory(
+    const uint16_t addr,
+    const size_t   size,
+    const uint8_t* read,
+    uint8_t*       write)
+{
+  this->cpu->map_memory(addr, size, read, write);
 }
 
 void bus::set_nmi(const bool value)
@@ -64,13 +91,38 @@ void bus::set_irq(const bool value)
   this->cpu->set_irq(value);
 }
 
+//
+// Scheduler access
+//
+
+void bus::schedule(const event_type::event_type event, const uint64_t cycle)
+{
+  this->cpu->schedule(event, cycle);
+}
+
+void bus::cancel(const event_type::event_type event)
+{
+  this->cpu->cancel(event);
+}
+
+// Called by the CPU when an event it doesn't handle itself comes due
+void bus::run_event(const event_type::event_type event)
+{
+  switch (event) {
+    case event_type::APU_Frame:
+    case event_type::APU_DMC: this->apu->run_event(event); break;
+    case event_type::MapperIRQ: this->cartridge->run_event(); break;
+    default: break;
+  }
+}
+
 //
 // PPU access
 //
 
-void bus::ppu_step()
+uint64_t bus::ppu_sync()
 {
-  this->ppu->step();
+  return this->ppu->sync(this->cpu->cycles());
 }
 
 uint8_t bus::ppu_read(const uint16_t addr)
@@ -83,9 +135,35 @@ void bus::ppu_write(const uint16_t addr, const uint8_t value)
   this->ppu->write(addr, value);
 }
 
+// The next sprite 0 hit may move, so the CPU asks the PPU again
 void bus::set_mirroring(const int mode)
 {
+  this->ppu_sync();
   this->ppu->set_mirroring(mode);
+  this->schedule(event_type::PPU, this->cpu_cycles());
+}
+
+void bus::oam_dma(const uint8_t* data)
+{
+  this->ppu->oam_dma(data);
+}
+
+void bus::map_chr_memory(
+    const uint16_t addr,
+    const size_t   size,
+    const uint8_t* read,
+    uint8_t*       write)
+{
+  this->ppu->map_chr(addr, size, read, write);
+}
+
+// Lines up to now are drawn with the old CHR, and the next sprite 0 hit may
+// move
+void bus::chr_map_changed(const uint16_t addr, const size_t size)
+{
+  this->ppu_sync();
+  this->ppu->chr_changed(addr, size);
+  this->schedule(event_type::PPU, this->cpu_cycles());
 }
 
 //
@@ -116,14 +194,9 @@ void bus::prg_write(const uint16_t addr, const uint8_t value)
   this->cartridge->prg_write(addr, value);
 }
 
-uint8_t bus::chr_read(const uint16_t addr) const
-{
-  return this->cartridge->chr_read(addr);
-}
-
-void bus::chr_write(const uint16_t addr, uint8_t value)
+int bus::prg_bank(const uint16_t addr) const
 {
-  this->cartridge->chr_write(addr, value);
+  return this->cartridge->prg_bank(addr);
 }
 
 //
@@ -153,7 +226,7 @@ void bus::nestest()
 // Emulator access
 //
 
-void bus::update_frame(const uint32_t* frame)
+void bus::update_frame(const nes::frame& frame)
 {
   this->emulator->update_frame(frame);
 }
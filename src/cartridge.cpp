@@ -37,11 +37,19 @@ void cartridge::load(const std::filesystem::path& rom_file)
   info.prg_ram_size = header[8] ? header[8] * 0x2000 : 0x2000;
   info.mirroring    = (header[6] & 1) ? Vertical : Horizontal;
 
+  // Four-screen cartridges bring their own VRAM, whatever bit 0 says
+  if (header[6] & 0x08) {
+    info.mirroring = FourScreen;
+  }
+
+  constexpr std::array<const char*, 5> mirroring_names = {
+      "Horizontal", "Vertical", "Single-screen (lower)",
+      "Single-screen (upper)", "Four-screen"};
+
   LOG(log::Info) << "16KB PRG-ROM banks: " << info.prg_banks;
   LOG(log::Info) << "8KB CHR-ROM banks: " << info.chr_banks;
   LOG(log::Info) << "Name table mirroring: " << +(header[6] & 0xB);
-  LOG(log::Info) << "Mirroring: "
-                 << (info.mirroring ? "Vertical" : "Horizontal");
+  LOG(log::Info) << "Mirroring: " << mirroring_names[info.mirroring];
   LOG(log::Info) << "Mapper #: " << info.mapper_num;
   LOG(log::Info) << "PRG RAM size: " << info.prg_ram_size;
 
@@ -83,13 +91,13 @@ void cartridge::prg_write(const uint16_t addr, const uint8_t value)
   mapper->prg_write(addr, value);
 }
 
-uint8_t cartridge::chr_read(const uint16_t addr) const
+int cartridge::prg_bank(const uint16_t addr) const
 {
-  return mapper->chr_read(addr);
+  return mapper->prg_bank(addr);
 }
 
-void cartridge::chr_write(const uint16_t addr, const uint8_t value)
+void cartridge::run_event()
 {
-  mapper->chr_write(addr, value);
+  mapper->run_event();
 }
 }  // namespace nes
\ No newline at end of file
@@ -0,0 +1,313 @@
+#include "compositor.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || \
+    defined(_M_IX86)
+#define NES_X86
+#include <immintrin.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+// MSVC compiles any intrinsic without being told, GCC and Clang only in
+// functions targeting the instruction set
+#if defined(NES_X86) && !defined(_MSC_VER)
+#define NES_TARGET(isa) __attribute__((target(isa)))
+#else
+#define NES_TARGET(isa)
+#endif
+
+namespace nes {
+namespace {
+constexpr int width = compositor::width;
+
+// x 255 never reports a hit
+int first_hit(const int x)
+{
+  return x == width - 1 ? -1 : x;
+}
+
+int composite_scalar(
+    const uint8_t* background,
+    const uint8_t* sprites,
+    uint8_t*       out,
+    const bool     clip_background,
+    const bool     clip_sprites)
+{
+  int hit = -1;
+
+  for (int x = 0; x < width; ++x) {
+    const bool    left   = x < 8;
+    const uint8_t back   = left && clip_background ? 0 : background[x];
+    const uint8_t sprite = left && clip_sprites ? 0 : sprites[x];
+
+    if (hit < 0 && back && (sprite & sprite_pixel::Zero)) {
+      hit = x;
+    }
+
+    if (sprite && (!back || !(sprite & sprite_pixel::Behind))) {
+      out[x] = sprite & 0x1F;
+    } else {
+      out[x] = back;
+    }
+  }
+
+  return first_hit(hit);
+}
+
+void convert_scalar(
+    const uint8_t*  pixels,
+    const uint32_t* colors,
+    uint32_t*       out)
+{
+  for (int x = 0; x < width; ++x) {
+    out[x] = colors[pixels[x]];
+  }
+}
+
+#ifdef NES_X86
+int lowest_bit(const uint32_t value)
+{
+#ifdef _MSC_VER
+  unsigned long index = 0;
+  _BitScanForward(&index, value);
+  return static_cast<int>(index);
+#else
+  return __builtin_ctz(value);
+#endif
+}
+
+//
+// The vector kernels do the same as the scalar one a block of pixels at a
+// time, choosing between the layers with byte masks instead of branches.
+// Clipping only touches the first block
+//
+
+NES_TARGET("sse2")
+int composite_sse2(
+    const uint8_t* background,
+    const uint8_t* sprites,
+    uint8_t*       out,
+    const bool     clip_background,
+    const bool     clip_sprites)
+{
+  const __m128i zero   = _mm_setzero_si128();
+  const __m128i color  = _mm_set1_epi8(0x1F);
+  const __m128i behind = _mm_set1_epi8(sprite_pixel::Behind);
+  const __m128i first  = _mm_set1_epi8(sprite_pixel::Zero);
+  const __m128i all    = _mm_set1_epi8(-1);
+  const __m128i right  = _mm_set_epi64x(-1, 0);
+
+  int hit = -1;
+
+  for (int x = 0; x < width; x += 16) {
+    __m128i back = _mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(background + x));
+    __m128i sprite =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(sprites + x));
+
+    if (x == 0) {
+      back   = _mm_and_si128(back, clip_background ? right : all);
+      sprite = _mm_and_si128(sprite, clip_sprites ? right : all);
+    }
+
+    const __m128i back_clear = _mm_cmpeq_epi8(back, zero);
+    const __m128i in_front =
+        _mm_cmpeq_epi8(_mm_and_si128(sprite, behind), zero);
+    const __m128i shown = _mm_andnot_si128(_mm_cmpeq_epi8(sprite, zero),
+                                           _mm_or_si128(back_clear, in_front));
+
+    const __m128i merged =
+        _mm_or_si128(_mm_and_si128(shown, _mm_and_si128(sprite, color)),
+                     _mm_andnot_si128(shown, back));
+
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x), merged);
+
+    if (hit < 0) {
+      const __m128i hits = _mm_andnot_si128(
+          back_clear, _mm_cmpeq_epi8(_mm_and_si128(sprite, first), first));
+      const auto bits = static_cast<uint32_t>(_mm_movemask_epi8(hits));
+
+      if (bits) {
+        hit = x + lowest_bit(bits);
+      }
+    }
+  }
+
+  return first_hit(hit);
+}
+
+NES_TARGET("avx2")
+int composite_avx2(
+    const uint8_t* background,
+    const uint8_t* sprites,
+    uint8_t*       out,
+    const bool     clip_background,
+    const bool     clip_sprites)
+{
+  const __m256i zero   = _mm256_setzero_si256();
+  const __m256i color  = _mm256_set1_epi8(0x1F);
+  const __m256i behind = _mm256_set1_epi8(sprite_pixel::Behind);
+  const __m256i first  = _mm256_set1_epi8(sprite_pixel::Zero);
+  const __m256i all    = _mm256_set1_epi8(-1);
+  const __m256i right  = _mm256_set_epi64x(-1, -1, -1, 0);
+
+  int hit = -1;
+
+  for (int x = 0; x < width; x += 32) {
+    __m256i back = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(background + x));
+    __m256i sprite =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(sprites + x));
+
+    if (x == 0) {
+      back   = _mm256_and_si256(back, clip_background ? right : all);
+      sprite = _mm256_and_si256(sprite, clip_sprites ? right : all);
+    }
+
+    const __m256i back_clear = _mm256_cmpeq_epi8(back, zero);
+    const __m256i in_front =
+        _mm256_cmpeq_epi8(_mm256_and_si256(sprite, behind), zero);
+    const __m256i shown =
+        _mm256_andnot_si256(_mm256_cmpeq_epi8(sprite, zero),
+                            _mm256_or_si256(back_clear, in_front));
+
+    const __m256i merged = _mm256_blendv_epi8(
+        back, _mm256_and_si256(sprite, color), shown);
+
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + x), merged);
+
+    if (hit < 0) {
+      const __m256i hits = _mm256_andnot_si256(
+          back_clear,
+          _mm256_cmpeq_epi8(_mm256_and_si256(sprite, first), first));
+      const auto bits = static_cast<uint32_t>(_mm256_movemask_epi8(hits));
+
+      if (bits) {
+        hit = x + lowest_bit(bits);
+      }
+    }
+  }
+
+  return first_hit(hit);
+}
+
+// Eight lookups per gather, the indexes widened from bytes
+NES_TARGET("avx2")
+void convert_avx2(
+    const uint8_t*  pixels,
+    const uint32_t* colors,
+    uint32_t*       out)
+{
+  const auto* table = reinterpret_cast<const int*>(colors);
+
+  for (int x = 0; x < width; x += 8) {
+    const __m256i indexes = _mm256_cvtepu8_epi32(
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(pixels + x)));
+
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + x),
+                        _mm256_i32gather_epi32(table, indexes, 4));
+  }
+}
+
+//
+// Feature detection
+//
+
+struct cpuid_registers {
+  uint32_t eax = 0;
+  uint32_t ebx = 0;
+  uint32_t ecx = 0;
+  uint32_t edx = 0;
+};
+
+cpuid_registers cpuid(const uint32_t leaf, const uint32_t subleaf)
+{
+  cpuid_registers result;
+
+#ifdef _MSC_VER
+  int registers[4] = {};
+  __cpuidex(registers, static_cast<int>(leaf), static_cast<int>(subleaf));
+
+  result.eax = static_cast<uint32_t>(registers[0]);
+  result.ebx = static_cast<uint32_t>(registers[1]);
+  result.ecx = static_cast<uint32_t>(registers[2]);
+  result.edx = static_cast<uint32_t>(registers[3]);
+#else
+  __cpuid_count(leaf, subleaf, result.eax, result.ebx, result.ecx, result.edx);
+#endif
+
+  return result;
+}
+
+// Which register state the OS saves on context switches
+uint64_t enabled_state()
+{
+#ifdef _MSC_VER
+  return _xgetbv(0);
+#else
+  uint32_t low  = 0;
+  uint32_t high = 0;
+  __asm__("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+  return (static_cast<uint64_t>(high) << 32) | low;
+#endif
+}
+
+bool has_sse2()
+{
+  return cpuid(1, 0).edx & (1u << 26);
+}
+
+// AVX2 also needs the OS to save the YMM registers
+bool has_avx2()
+{
+  if (cpuid(0, 0).eax < 7) {
+    return false;
+  }
+
+  const auto     features = cpuid(1, 0);
+  const uint32_t osxsave  = 1u << 27;
+  const uint32_t avx      = 1u << 28;
+
+  if ((features.ecx & (osxsave | avx)) != (osxsave | avx) ||
+      (enabled_state() & 0x06) != 0x06) {
+    return false;
+  }
+
+  return cpuid(7, 0).ebx & (1u << 5);
+}
+#endif
+
+constexpr compositor scalar = {"scalar", composite_scalar, convert_scalar};
+
+#ifdef NES_X86
+// SSE2 has nothing for table lookups wider than a byte
+constexpr compositor sse2 = {"SSE2", composite_sse2, convert_scalar};
+constexpr compositor avx2 = {"AVX2", composite_avx2, convert_avx2};
+#endif
+
+const compositor& select()
+{
+#ifdef NES_X86
+  if (has_avx2()) {
+    return avx2;
+  }
+
+  if (has_sse2()) {
+    return sse2;
+  }
+#endif
+
+  return scalar;
+}
+}  // namespace
+
+const compositor& compositor::best()
+{
+  static const compositor& selected = select();
+  return selected;
+}
+}  // namespace nes
@@ -1,11 +1,37 @@
 #include "cpu.h"
 
+#include <algorithm>
 #include <iostream>
 #include <stdexcept>
 
 #include "log.h"
+#include "opcodes.h"
 
 namespace nes {
+cpu::cpu()
+{
+  for (size_t i = 0; i < pages.size(); ++i) {
+    auto& page = pages[i];
+
+    if (i < 0x20) {
+      // 2KB of RAM mirrored up to 0x1FFF
+      page.read  = &ram[(i % 8) * 0x100];
+      page.write = &ram[(i % 8) * 0x100];
+    } else if (i < 0x40) {
+      page.on_read  = &cpu::read_ppu;
+      page.on_write = &cpu::write_ppu;
+    } else if (i < 0x60) {
+      page.on_read  = &cpu::read_io;
+      page.on_write = &cpu::write_io;
+    } else {
+      page.on_read  = &cpu::read_cartridge;
+      page.on_write = &cpu::write_cartridge;
+    }
+  }
+
+  events.schedule(event_type::PPU, 0);
+}
+
 void cpu::set_bus(nes::bus& ref)
 {
   this->bus = &ref;
@@ -13,110 +39,362 @@ void cpu::set_bus(nes::bus& ref)
 
 void cpu::power_on()
 {
-  remaining_cycles = 0;
-  ram.fill(0);
+  frame_end = state.cycle_count;
+  this->clear_ram();
   state.set_ps(0x34);
   INT_RST();
 }
 
 void cpu::reset()
 {
-  remaining_cycles = 0;
-  ram.fill(0);
+  frame_end = state.cycle_count;
+  this->clear_ram();
   state.set_ps(0x34);
   INT_RST();
 }
 
+// Goes around write_code, so the blocks decoded from RAM are dropped here
+void cpu::clear_ram()
+{
+  ram.fill(0);
+
+  for (size_t offset = 0; offset < ram.size(); offset += 0x100) {
+    invalidate_code(&ram[offset]);
+  }
+}
+
 void cpu::set_nmi(const bool value)
 {
   this->state.nmi_flag = value;
+  recheck_interrupts();
 }
 
 void cpu::set_irq(const bool value)
 {
   this->state.irq_flag = value;
+  recheck_interrupts();
 }
 
-void cpu::dma_oam(const uint8_t addr)
+void cpu::dma_oam(const uint8_t page_num)
 {
-  for (size_t i = 0; i < 256; ++i) {
-    // 0x2014 == OAMDATA
-    memory_write(0x2014, memory_read((addr * 0x100) + i));
+  const auto& page = pages[page_num];
+
+  // The CPU halts for one cycle, plus one more to line up with a read cycle
+  tick(1);
+
+  if (state.cycle_count % 2) {
+    tick(1);
+  }
+
+  if (page.read) {
+    // Nothing can write RAM or PRG ROM during the stall, so the page is copied
+    // all at once. The PPU is caught up to the end of the transfer first, so
+    // it sees the old OAM for as long as the stall lasts
+    tick(512);
+    ppu_sync();
+    this->bus->oam_dma(page.read);
+
+    // Sprite 0 may have moved, and with it the next hit
+    schedule(event_type::PPU, state.cycle_count);
+  } else {
+    for (size_t i = 0; i < 256; ++i) {
+      // 0x2004 == OAMDATA
+      memory_write<accuracy::Cycle>(
+          0x2004,
+          memory_read<accuracy::Cycle>((page_num * 0x100) + i));
+    }
   }
 }
 
 void cpu::run_frame()
 {
-  remaining_cycles += total_cycles;
+  frame_end += total_cycles;
+  schedule(event_type::FrameEnd, frame_end);
+
+#ifdef NES_PROFILER
+  if (profiler) {
+    accuracy_mode == accuracy::Cycle ? run_profiled<accuracy::Cycle>()
+                                     : run_profiled<accuracy::Instruction>();
+    ppu_sync();
+    return;
+  }
+#endif
+
+  if (accuracy_mode == accuracy::Cycle) {
+    block_cache ? run_cached<accuracy::Cycle>() : run<accuracy::Cycle>();
+  } else {
+    block_cache ? run_cached<accuracy::Instruction>()
+                : run<accuracy::Instruction>();
+  }
+
+  ppu_sync();
+}
+
+void cpu::use_block_cache(const bool value)
+{
+  block_cache = value;
+}
+
+void cpu::skip_idle_loops(const bool value)
+{
+  idle_skip = value;
+}
+
+#ifdef NES_PROFILER
+// nullptr turns profiling back off
+void cpu::set_profiler(nes::profiler* value)
+{
+  profiler = value;
+}
+#endif
+
+// Decoded blocks hold handlers of one accuracy, so switching drops them
+void cpu::set_accuracy(const accuracy::accuracy value)
+{
+  if (value == accuracy_mode) {
+    return;
+  }
 
-  while (remaining_cycles > 0) {
-    if (state.nmi_flag) {
-      INT_NMI();
-    } else if (state.irq_flag && !state.check_flags(flags::Interrupt)) {
-      INT_IRQ();
+  accuracy_mode = value;
+
+  for (auto& page : pages) {
+    if (page.code_write) {
+      page.write      = page.code_write;
+      page.code_write = nullptr;
     }
 
-    execute();
+    page.code = nullptr;
+  }
+
+  code_cache.clear();
+  code_modified = true;
+}
+
+// nullptr stops the recording, the ring keeps what it has
+void cpu::set_trace(nes::trace_ring* value)
+{
+  trace = value;
+}
+
+void cpu::dump_trace(const std::filesystem::path& path) const
+{
+  if (trace) {
+    trace->dump(path);
   }
+}
+
+uint64_t cpu::cycles() const
+{
+  return state.cycle_count;
+}
+
+int cpu::frame_cycles() const
+{
+  return total_cycles;
+}
 
-  // state.cycle_count = 0;
+void cpu::schedule(const event_type::event_type event, const uint64_t cycle)
+{
+  events.schedule(event, cycle);
+  next_event = std::min(next_event, cycle);
+}
+
+void cpu::cancel(const event_type::event_type event)
+{
+  events.cancel(event);
 }
 
-void cpu::tick()
+// Handles every event that is due, then takes a pending interrupt. Returns
+// false instead once the frame is over
+template <auto Accuracy> bool cpu::handle_events()
 {
-  this->bus->ppu_step();
-  this->bus->ppu_step();
-  this->bus->ppu_step();
-  --remaining_cycles;
+  if (state.cycle_count >= frame_end) {
+    return false;
+  }
+
+  while (events.next() <= state.cycle_count) {
+    const auto event = events.top();
+    events.cancel(event);
+
+    switch (event) {
+      case event_type::PPU: ppu_sync(); break;
+      default: this->bus->run_event(event); break;
+    }
+  }
+
+  next_event = events.next();
+
+  if (state.nmi_flag) {
+    INT_NMI<Accuracy>();
+  } else if (state.irq_flag && !state.check_flags(flags::Interrupt)) {
+    INT_IRQ<Accuracy>();
+  }
 
-  // ++state.cycle_count;
+  return true;
+}
+
+template bool cpu::handle_events<accuracy::Cycle>();
+template bool cpu::handle_events<accuracy::Instruction>();
+
+// Makes the run loop look at the interrupt lines before the next opcode
+void cpu::recheck_interrupts()
+{
+  next_event = state.cycle_count;
+}
+
+void cpu::ppu_sync()
+{
+  schedule(event_type::PPU, this->bus->ppu_sync());
 }
 
 uint8_t cpu::read(const uint16_t addr) const
+{
+  const auto& page = pages[addr >> 8];
+
+  if (page.read) {
+    return page.read[addr & 0xFF];
+  }
+
+  return page.on_read(*this, addr);
+}
+
+void cpu::write(const uint16_t addr, const uint8_t value)
+{
+  const auto& page = pages[addr >> 8];
+
+  if (page.write) {
+    page.write[addr & 0xFF] = value;
+  } else if (page.code_write) {
+    write_code(addr, value);
+  } else {
+    page.on_write(*this, addr, value);
+  }
+}
+
+//
+// Memory map
+//
+
+void cpu::map_memory(
+    const uint16_t addr,
+    const size_t   size,
+    const uint8_t* read_ptr,
+    uint8_t*       write_ptr)
+{
+  for (size_t offset = 0; offset < size; offset += 0x100) {
+    auto& page = pages[(addr + offset) >> 8];
+
+    page.read       = read_ptr ? read_ptr + offset : nullptr;
+    page.write      = write_ptr ? write_ptr + offset : nullptr;
+    page.code       = nullptr;
+    page.code_write = nullptr;
+
+    // Writable memory that already holds decoded code stays guarded
+    if (page.write && code_cache.count(page.read)) {
+      protect_code(page.read);
+    }
+  }
+
+  // The running block may have just been switched out
+  code_modified = true;
+}
+
+// Guards every mapping of a page of host memory holding decoded code
+void cpu::protect_code(const uint8_t* host)
+{
+  for (auto& page : pages) {
+    if (page.read == host && page.write) {
+      page.code_write = page.write;
+      page.write      = nullptr;
+    }
+  }
+}
+
+// Drops the decoded code of a page of host memory and lifts the guard
+void cpu::invalidate_code(const uint8_t* host)
+{
+  const auto it = code_cache.find(host);
+
+  if (it != code_cache.end()) {
+    it->second.block_at.fill(no_block);
+    it->second.entries.clear();
+  }
+
+  for (auto& page : pages) {
+    if (page.read == host && page.code_write) {
+      page.write      = page.code_write;
+      page.code_write = nullptr;
+    }
+  }
+
+  code_modified = true;
+}
+
+void cpu::write_code(const uint16_t addr, const uint8_t value)
+{
+  invalidate_code(pages[addr >> 8].read);
+  write(addr, value);
+}
+
+uint8_t cpu::read_ppu(const nes::cpu& cpu, const uint16_t addr)
+{
+  cpu.bus->ppu_sync();
+  return cpu.bus->ppu_read(addr);
+}
+
+uint8_t cpu::read_io(const nes::cpu& cpu, const uint16_t addr)
 {
   using namespace memory;
 
   switch (get_cpu_map<Read>(addr)) {
-    case CPU_RAM: return this->ram[addr % 0x800];
-    case PPU_Access: return this->bus->ppu_read(addr);
-    case APU_Access: return this->bus->apu_read(elapsed());
-    case Controller_1: return this->bus->controller_read(0);
-    case Controller_2: return this->bus->controller_read(1);
-    case Cartridge: return this->bus->prg_read(addr);
+    case APU_Access: return cpu.bus->apu_read(cpu.elapsed());
+    case Controller_1: return cpu.bus->controller_read(0);
+    case Controller_2: return cpu.bus->controller_read(1);
     default: throw std::runtime_error("Invalid read address");
   }
 }
 
-void cpu::write(const uint16_t addr, const uint8_t value)
+uint8_t cpu::read_cartridge(const nes::cpu& cpu, const uint16_t addr)
+{
+  return cpu.bus->prg_read(addr);
+}
+
+void cpu::write_ppu(nes::cpu& cpu, const uint16_t addr, const uint8_t value)
+{
+  cpu.ppu_sync();
+  cpu.bus->ppu_write(addr, value);
+
+  // The write may have moved the next event
+  cpu.schedule(event_type::PPU, cpu.state.cycle_count);
+}
+
+void cpu::write_io(nes::cpu& cpu, const uint16_t addr, const uint8_t value)
 {
   using namespace memory;
 
   switch (get_cpu_map<Write>(addr)) {
-    case CPU_RAM: this->ram[addr % 0x800] = value; break;
-    case PPU_Access: this->bus->ppu_write(addr, value); break;
-    case APU_Access: this->bus->apu_write(elapsed(), addr, value); break;
-    case OAMDMA: this->dma_oam(value); break;
-    case Controller: this->bus->controller_write(value & 1); break;
-    case Cartridge: this->bus->prg_write(addr, value); break;
+    case APU_Access: cpu.bus->apu_write(cpu.elapsed(), addr, value); break;
+    case OAMDMA: cpu.dma_oam(value); break;
+    case Controller: cpu.bus->controller_write(value & 1); break;
+    case Cartridge: cpu.bus->prg_write(addr, value); break;
     default: throw std::runtime_error("Invalid write address");
   }
 }
 
-uint8_t cpu::memory_read(const uint16_t addr)
+void cpu::write_cartridge(
+    nes::cpu&      cpu,
+    const uint16_t addr,
+    const uint8_t  value)
 {
-  tick();
-  return this->read(addr);
-}
-
-void cpu::memory_write(const uint16_t addr, const uint8_t value)
-{
-  tick();
-  this->write(addr, value);
+  cpu.bus->prg_write(addr, value);
 }
 
+// Reads without side effects for the debugging tools. Registers behind a
+// handler read as 0xFF, which is also how the nestest log shows them
 uint8_t cpu::peek(const uint16_t addr) const
 {
-  return this->read(addr);
+  const auto& page = pages[addr >> 8];
+  return page.read ? page.read[addr & 0xFF] : 0xFF;
 }
 
 uint16_t cpu::peek_imm() const
@@ -181,8 +459,42 @@ uint16_t cpu::peek_indy() const
   return ((peek((base_addr + 1) & 0xFF) << 8) | peek(base_addr)) + state.y;
 }
 
+void cpu::trace_instruction()
+{
+  using namespace addressing_mode;
+
+  nes::trace_record record;
+
+  record.cycle      = state.cycle_count;
+  record.pc         = state.pc;
+  record.opcode     = peek(state.pc);
+  record.operand[0] = peek(state.pc + 1);
+  record.operand[1] = peek(state.pc + 2);
+  record.a          = state.a;
+  record.x          = state.x;
+  record.y          = state.y;
+  record.p          = state.ps();
+  record.sp         = state.sp;
+
+  switch (opcodes::mode(record.opcode)) {
+    case ZeroPage: record.address = peek_zp(); break;
+    case ZeroPageX: record.address = peek_zpx(); break;
+    case ZeroPageY: record.address = peek_zpy(); break;
+    case Absolute: record.address = peek_ab(); break;
+    case AbsoluteX: record.address = peek_abx(); break;
+    case AbsoluteY: record.address = peek_aby(); break;
+    case Indirect: record.address = peek_ind(); break;
+    case IndirectX: record.address = peek_indx(); break;
+    case IndirectY: record.address = peek_indy(); break;
+    default: trace->push(record); return;
+  }
+
+  record.value = peek(record.address);
+  trace->push(record);
+}
+
 int cpu::elapsed() const
 {
-  return total_cycles - remaining_cycles;
+  return static_cast<int>(state.cycle_count + total_cycles - frame_end);
 }
 }  // namespace nes
\ No newline at end of file
@@ -1,299 +1,814 @@
 #include "cpu.h"
 
-#include <iostream>
-#include <stdexcept>
-
-#include "log.h"
+#include <array>
 
 using namespace nes::addressing_mode;
 
 namespace nes {
-template uint16_t    cpu::get_operand<Immediate>();
-template uint16_t    cpu::get_operand<Relative>();
-template <> uint16_t cpu::get_operand<ZeroPage>();
-template <> uint16_t cpu::get_operand<ZeroPageX>();
-template <> uint16_t cpu::get_operand<ZeroPageY>();
-template <> uint16_t cpu::get_operand<Absolute>();
-template <> uint16_t cpu::get_operand<AbsoluteX>();
-template <> uint16_t cpu::get_operand<AbsoluteX_Exception>();
-template <> uint16_t cpu::get_operand<AbsoluteY>();
-template <> uint16_t cpu::get_operand<AbsoluteY_Exception>();
-template <> uint16_t cpu::get_operand<Indirect>();
-template <> uint16_t cpu::get_operand<IndirectX>();
-template <> uint16_t cpu::get_operand<IndirectY>();
-template <> uint16_t cpu::get_operand<IndirectY_Exception>();
-
-void cpu::execute()
-{
-  const auto opcode = memory_read(get_operand<Immediate>());
+template <void (cpu::*Instruction)()> void cpu::invoke(nes::cpu& cpu)
+{
+  (cpu.*Instruction)();
+}
+
+//
+// Every opcode, including the unofficial and the halting ones, gets its own
+// entry so decoding never falls through to an error path
+//
+
+template <auto Accuracy>
+constexpr std::array<cpu::opcode_handler, 0x100> cpu::opcode_table()
+{
+  std::array<opcode_handler, 0x100> table{};
+
+  // 0x00 - 0x0F
+  table[0x00] = &invoke<&cpu::INT_BRK<Accuracy>>;
+  table[0x01] = &invoke<&cpu::ORA<Accuracy, IndirectX>>;
+  table[0x02] = &invoke<&cpu::JAM<Accuracy>>;
+  table[0x03] = &invoke<&cpu::SLO<Accuracy, IndirectX>>;
+  table[0x04] = &invoke<&cpu::NOP<Accuracy, ZeroPage>>;
+  table[0x05] = &invoke<&cpu::ORA<Accuracy, ZeroPage>>;
+  table[0x06] = &invoke<&cpu::ASL<Accuracy, ZeroPage>>;
+  table[0x07] = &invoke<&cpu::SLO<Accuracy, ZeroPage>>;
+  table[0x08] = &invoke<&cpu::PHP<Accuracy>>;
+  table[0x09] = &invoke<&cpu::ORA<Accuracy, Immediate>>;
+  table[0x0A] = &invoke<&cpu::ASL<Accuracy, Accumulator>>;
+  table[0x0B] = &invoke<&cpu::ANC<Accuracy, Immediate>>;
+  table[0x0C] = &invoke<&cpu::NOP<Accuracy, Absolute>>;
+  table[0x0D] = &invoke<&cpu::ORA<Accuracy, Absolute>>;
+  table[0x0E] = &invoke<&cpu::ASL<Accuracy, Absolute>>;
+  table[0x0F] = &invoke<&cpu::SLO<Accuracy, Absolute>>;
+
+  // 0x10 - 0x1F
+  table[0x10] = &invoke<&cpu::BPL<Accuracy>>;
+  table[0x11] = &invoke<&cpu::ORA<Accuracy, IndirectY>>;
+  table[0x12] = &invoke<&cpu::JAM<Accuracy>>;
+  table[0x13] = &invoke<&cpu::SLO<Accuracy, IndirectY>>;
+  table[0x14] = &invoke<&cpu::NOP<Accuracy, ZeroPageX>>;
+  table[0x15] = &invoke<&cpu::ORA<Accuracy, ZeroPageX>>;
+  table[0x16] = &invoke<&cpu::ASL<Accuracy, ZeroPageX>>;
+  table[0x17] = &invoke<&cpu::SLO<Accuracy, ZeroPageX>>;
+  table[0x18] = &invoke<&cpu::CLC<Accuracy>>;
+  table[0x19] = &invoke<&cpu::ORA<Accuracy, AbsoluteY>>;
+  table[0x1A] = &invoke<&cpu::NOP<Accuracy>>;
+  table[0x1B] = &invoke<&cpu::SLO<Accuracy, AbsoluteY>>;
+  table[0x1C] = &invoke<&cpu::NOP<Accuracy, AbsoluteX>>;
+  table[0x1D] = &invoke<&cpu::ORA<Accuracy, AbsoluteX>>;
+  table[0x1E] = &invoke<&cpu::ASL<Accuracy, AbsoluteX_Exception>>;
+  table[0x1F] = &invoke<&cpu::SLO<Accuracy, AbsoluteX>>;
+
+  // 0x20 - 0x2F
+  table[0x20] = &invoke<&cpu::JSR<Accuracy>>;
+  table[0x21] = &invoke<&cpu::AND<Accuracy, IndirectX>>;
+  table[0x22] = &invoke<&cpu::JAM<Accuracy>>;
+  table[0x23] = &invoke<&cpu::RLA<Accuracy, IndirectX>>;
+  table[0x24] = &invoke<&cpu::BIT<Accuracy, ZeroPage>>;
+  table[0x25] = &invoke<&cpu::AND<Accuracy, ZeroPage>>;
+  table[0x26] = &invoke<&cpu::ROL<Accuracy, ZeroPage>>;
+  table[0x27] = &invoke<&cpu::RLA<Accuracy, ZeroPage>>;
+  table[0x28] = &invoke<&cpu::PLP<Accuracy>>;
+  table[0x29] = &invoke<&cpu::AND<Accuracy, Immediate>>;
+  table[0x2A] = &invoke<&cpu::ROL<Accuracy, Accumulator>>;
+  table[0x2B] = &invoke<&cpu::ANC<Accuracy, Immediate>>;
+  table[0x2C] = &invoke<&cpu::BIT<Accuracy, Absolute>>;
+  table[0x2D] = &invoke<&cpu::AND<Accuracy, Absolute>>;
+  table[0x2E] = &invoke<&cpu::ROL<Accuracy, Absolute>>;
+  table[0x2F] = &invoke<&cpu::RLA<Accuracy, Absolute>>;
+
+  // 0x30 - 0x3F
+  table[0x30] = &invoke<&cpu::BMI<Accuracy>>;
+  table[0x31] = &invoke<&cpu::AND<Accuracy, IndirectY>>;
+  table[0x32] = &invoke<&cpu::JAM<Accuracy>>;
+  table[0x33] = &invoke<&cpu::RLA<Accuracy, IndirectY>>;
+  table[0x34] = &invoke<&cpu::NOP<Accuracy, ZeroPageX>>;
+  table[0x35] = &invoke<&cpu::AND<Accuracy, ZeroPageX>>;
+  table[0x36] = &invoke<&cpu::ROL<Accuracy, ZeroPageX>>;
+  table[0x37] = &invoke<&cpu::RLA<Accuracy, ZeroPageX>>;
+  table[0x38] = &invoke<&cpu::SEC<Accuracy>>;
+  table[0x39] = &invoke<&cpu::AND<Accuracy, AbsoluteY>>;
+  table[0x3A] = &invoke<&cpu::NOP<Accuracy>>;
+  table[0x3B] = &invoke<&cpu::RLA<Accuracy, AbsoluteY>>;
+  table[0x3C] = &invoke<&cpu::NOP<Accuracy, AbsoluteX>>;
+  table[0x3D] = &invoke<&cpu::AND<Accuracy, AbsoluteX>>;
+  table[0x3E] = &invoke<&cpu::ROL<Accuracy, AbsoluteX_Exception>>;
+  table[0x3F] = &invoke<&cpu::RLA<Accuracy, AbsoluteX>>;
+
+  // 0x40 - 0x4F
+  table[0x40] = &invoke<&cpu::RTI<Accuracy>>;
+  table[0x41] = &invoke<&cpu::EOR<Accuracy, IndirectX>>;
+  table[0x42] = &invoke<&cpu::JAM<Accuracy>>;
+  table[0x43] = &invoke<&cpu::SRE<Accuracy, IndirectX>>;
+  table[0x44] = &invoke<&cpu::NOP<Accuracy, ZeroPage>>;
+  table[0x45] = &invoke<&cpu::EOR<Accuracy, ZeroPage>>;
+  table[0x46] = &invoke<&cpu::LSR<Accuracy, ZeroPage>>;
+  table[0x47] = &invoke<&cpu::SRE<Accuracy, ZeroPage>>;
+  table[0x48] = &invoke<&cpu::PHA<Accuracy>>;
+  table[0x49] = &invoke<&cpu::EOR<Accuracy, Immediate>>;
+  table[0x4A] = &invoke<&cpu::LSR<Accuracy, Accumulator>>;
+  table[0x4B] = &invoke<&cpu::ALR<Accuracy, Immediate>>;
+  table[0x4C] = &invoke<&cpu::JMP<Accuracy, Absolute>>;
+  table[0x4D] = &invoke<&cpu::EOR<Accuracy, Absolute>>;
+  table[0x4E] = &invoke<&cpu::LSR<Accuracy, Absolute>>;
+  table[0x4F] = &invoke<&cpu::SRE<Accuracy, Absolute>>;
+
+  // 0x50 - 0x5F
+  table[0x50] = &invoke<&cpu::BVC<Accuracy>>;
+  table[0x51] = &invoke<&cpu::EOR<Accuracy, IndirectY>>;
+  table[0x52] = &invoke<&cpu::JAM<Accuracy>>;
+  table[0x53] = &invoke<&cpu::SRE<Accuracy, IndirectY>>;
+  table[0x54] = &invoke<&cpu::NOP<Accuracy, ZeroPageX>>;
+  table[0x55] = &invoke<&cpu::EOR<Accuracy, ZeroPageX>>;
+  table[0x56] = &invoke<&cpu::LSR<Accuracy, ZeroPageX>>;
+  table[0x57] = &invoke<&cpu::SRE<Accuracy, ZeroPageX>>;
+  table[0x58] = &invoke<&cpu::CLI<Accuracy>>;
+  table[0x59] = &invoke<&cpu::EOR<Accuracy, AbsoluteY>>;
+  table[0x5A] = &invoke<&cpu::NOP<Accuracy>>;
+  table[0x5B] = &invoke<&cpu::SRE<Accuracy, AbsoluteY>>;
+  table[0x5C] = &invoke<&cpu::NOP<Accuracy, AbsoluteX>>;
+  table[0x5D] = &invoke<&cpu::EOR<Accuracy, AbsoluteX>>;
+  table[0x5E] = &invoke<&cpu::LSR<Accuracy, AbsoluteX_Exception>>;
+  table[0x5F] = &invoke<&cpu::SRE<Accuracy, AbsoluteX>>;
+
+  // 0x60 - 0x6F
+  table[0x60] = &invoke<&cpu::RTS<Accuracy>>;
+  table[0x61] = &invoke<&cpu::ADC<Accuracy, IndirectX>>;
+  table[0x62] = &invoke<&cpu::JAM<Accuracy>>;
+  table[0x63] = &invoke<&cpu::RRA<Accuracy, IndirectX>>;
+  table[0x64] = &invoke<&cpu::NOP<Accuracy, ZeroPage>>;
+  table[0x65] = &invoke<&cpu::ADC<Accuracy, ZeroPage>>;
+  table[0x66] = &invoke<&cpu::ROR<Accuracy, ZeroPage>>;
+  table[0x67] = &invoke<&cpu::RRA<Accuracy, ZeroPage>>;
+  table[0x68] = &invoke<&cpu::PLA<Accuracy>>;
+  table[0x69] = &invoke<&cpu::ADC<Accuracy, Immediate>>;
+  table[0x6A] = &invoke<&cpu::ROR<Accuracy, Accumulator>>;
+  table[0x6B] = &invoke<&cpu::ARR<Accuracy, Immediate>>;
+  table[0x6C] = &invoke<&cpu::JMP<Accuracy, Indirect>>;
+  table[0x6D] = &invoke<&cpu::ADC<Accuracy, Absolute>>;
+  table[0x6E] = &invoke<&cpu::ROR<Accuracy, Absolute>>;
+  table[0x6F] = &invoke<&cpu::RRA<Accuracy, Absolute>>;
+
+  // 0x70 - 0x7F
+  table[0x70] = &invoke<&cpu::BVS<Accuracy>>;
+  table[0x71] = &invoke<&cpu::ADC<Accuracy, IndirectY>>;
+  table[0x72] = &invoke<&cpu::JAM<Accuracy>>;
+  table[0x73] = &invoke<&cpu::RRA<Accuracy, IndirectY>>;
+  table[0x74] = &invoke<&cpu::NOP<Accuracy, ZeroPageX>>;
+  table[0x75] = &invoke<&cpu::ADC<Accuracy, ZeroPageX>>;
+  table[0x76] = &invoke<&cpu::ROR<Accuracy, ZeroPageX>>;
+  table[0x77] = &invoke<&cpu::RRA<Accuracy, ZeroPageX>>;
+  table[0x78] = &invoke<&cpu::SEI<Accuracy>>;
+  table[0x79] = &invoke<&cpu::ADC<Accuracy, AbsoluteY>>;
+  table[0x7A] = &invoke<&cpu::NOP<Accuracy>>;
+  table[0x7B] = &invoke<&cpu::RRA<Accuracy, AbsoluteY>>;
+  table[0x7C] = &invoke<&cpu::NOP<Accuracy, AbsoluteX>>;
+  table[0x7D] = &invoke<&cpu::ADC<Accuracy, AbsoluteX>>;
+  table[0x7E] = &invoke<&cpu::ROR<Accuracy, AbsoluteX_Exception>>;
+  table[0x7F] = &invoke<&cpu::RRA<Accuracy, AbsoluteX>>;
+
+  // 0x80 - 0x8F
+  table[0x80] = &invoke<&cpu::NOP<Accuracy, Immediate>>;
+  table[0x81] = &invoke<&cpu::STA<Accuracy, IndirectX>>;
+  table[0x82] = &invoke<&cpu::NOP<Accuracy, Immediate>>;
+  table[0x83] = &invoke<&cpu::SAX<Accuracy, IndirectX>>;
+  table[0x84] = &invoke<&cpu::STY<Accuracy, ZeroPage>>;
+  table[0x85] = &invoke<&cpu::STA<Accuracy, ZeroPage>>;
+  table[0x86] = &invoke<&cpu::STX<Accuracy, ZeroPage>>;
+  table[0x87] = &invoke<&cpu::SAX<Accuracy, ZeroPage>>;
+  table[0x88] = &invoke<&cpu::DEY<Accuracy>>;
+  table[0x89] = &invoke<&cpu::NOP<Accuracy, Immediate>>;
+  table[0x8A] = &invoke<&cpu::TXA<Accuracy>>;
+  table[0x8B] = &invoke<&cpu::XAA<Accuracy, Immediate>>;
+  table[0x8C] = &invoke<&cpu::STY<Accuracy, Absolute>>;
+  table[0x8D] = &invoke<&cpu::STA<Accuracy, Absolute>>;
+  table[0x8E] = &invoke<&cpu::STX<Accuracy, Absolute>>;
+  table[0x8F] = &invoke<&cpu::SAX<Accuracy, Absolute>>;
+
+  // 0x90 - 0x9F
+  table[0x90] = &invoke<&cpu::BCC<Accuracy>>;
+  table[0x91] = &invoke<&cpu::STA<Accuracy, IndirectY_Exception>>;
+  table[0x92] = &invoke<&cpu::JAM<Accuracy>>;
+  table[0x93] = &invoke<&cpu::AHX<Accuracy, IndirectY_Exception>>;
+  table[0x94] = &invoke<&cpu::STY<Accuracy, ZeroPageX>>;
+  table[0x95] = &invoke<&cpu::STA<Accuracy, ZeroPageX>>;
+  table[0x96] = &invoke<&cpu::STX<Accuracy, ZeroPageY>>;
+  table[0x97] = &invoke<&cpu::SAX<Accuracy, ZeroPageY>>;
+  table[0x98] = &invoke<&cpu::TYA<Accuracy>>;
+  table[0x99] = &invoke<&cpu::STA<Accuracy, AbsoluteY_Exception>>;
+  table[0x9A] = &invoke<&cpu::TXS<Accuracy>>;
+  table[0x9B] = &invoke<&cpu::TAS<Accuracy, AbsoluteY_Exception>>;
+  table[0x9C] = &invoke<&cpu::SHY<Accuracy, AbsoluteX_Exception>>;
+  table[0x9D] = &invoke<&cpu::STA<Accuracy, AbsoluteX_Exception>>;
+  table[0x9E] = &invoke<&cpu::SHX<Accuracy, AbsoluteY_Exception>>;
+  table[0x9F] = &invoke<&cpu::AHX<Accuracy, AbsoluteY_Exception>>;
+
+  // 0xA0 - 0xAF
+  table[0xA0] = &invoke<&cpu::LDY<Accuracy, Immediate>>;
+  table[0xA1] = &invoke<&cpu::LDA<Accuracy, IndirectX>>;
+  table[0xA2] = &invoke<&cpu::LDX<Accuracy, Immediate>>;
+  table[0xA3] = &invoke<&cpu::LAX<Accuracy, IndirectX>>;
+  table[0xA4] = &invoke<&cpu::LDY<Accuracy, ZeroPage>>;
+  table[0xA5] = &invoke<&cpu::LDA<Accuracy, ZeroPage>>;
+  table[0xA6] = &invoke<&cpu::LDX<Accuracy, ZeroPage>>;
+  table[0xA7] = &invoke<&cpu::LAX<Accuracy, ZeroPage>>;
+  table[0xA8] = &invoke<&cpu::TAY<Accuracy>>;
+  table[0xA9] = &invoke<&cpu::LDA<Accuracy, Immediate>>;
+  table[0xAA] = &invoke<&cpu::TAX<Accuracy>>;
+  table[0xAB] = &invoke<&cpu::LAX<Accuracy, Immediate>>;
+  table[0xAC] = &invoke<&cpu::LDY<Accuracy, Absolute>>;
+  table[0xAD] = &invoke<&cpu::LDA<Accuracy, Absolute>>;
+  table[0xAE] = &invoke<&cpu::LDX<Accuracy, Absolute>>;
+  table[0xAF] = &invoke<&cpu::LAX<Accuracy, Absolute>>;
+
+  // 0xB0 - 0xBF
+  table[0xB0] = &invoke<&cpu::BCS<Accuracy>>;
+  table[0xB1] = &invoke<&cpu::LDA<Accuracy, IndirectY>>;
+  table[0xB2] = &invoke<&cpu::JAM<Accuracy>>;
+  table[0xB3] = &invoke<&cpu::LAX<Accuracy, IndirectY>>;
+  table[0xB4] = &invoke<&cpu::LDY<Accuracy, ZeroPageX>>;
+  table[0xB5] = &invoke<&cpu::LDA<Accuracy, ZeroPageX>>;
+  table[0xB6] = &invoke<&cpu::LDX<Accuracy, ZeroPageY>>;
+  table[0xB7] = &invoke<&cpu::LAX<Accuracy, ZeroPageY>>;
+  table[0xB8] = &invoke<&cpu::CLV<Accuracy>>;
+  table[0xB9] = &invoke<&cpu::LDA<Accuracy, AbsoluteY>>;
+  table[0xBA] = &invoke<&cpu::TSX<Accuracy>>;
+  table[0xBB] = &invoke<&cpu::LAS<Accuracy, AbsoluteY>>;
+  table[0xBC] = &invoke<&cpu::LDY<Accuracy, AbsoluteX>>;
+  table[0xBD] = &invoke<&cpu::LDA<Accuracy, AbsoluteX>>;
+  table[0xBE] = &invoke<&cpu::LDX<Accuracy, AbsoluteY>>;
+  table[0xBF] = &invoke<&cpu::LAX<Accuracy, AbsoluteY>>;
+
+  // 0xC0 - 0xCF
+  table[0xC0] = &invoke<&cpu::CPY<Accuracy, Immediate>>;
+  table[0xC1] = &invoke<&cpu::CMP<Accuracy, IndirectX>>;
+  table[0xC2] = &invoke<&cpu::NOP<Accuracy, Immediate>>;
+  table[0xC3] = &invoke<&cpu::DCP<Accuracy, IndirectX>>;
+  table[0xC4] = &invoke<&cpu::CPY<Accuracy, ZeroPage>>;
+  table[0xC5] = &invoke<&cpu::CMP<Accuracy, ZeroPage>>;
+  table[0xC6] = &invoke<&cpu::DEC<Accuracy, ZeroPage>>;
+  table[0xC7] = &invoke<&cpu::DCP<Accuracy, ZeroPage>>;
+  table[0xC8] = &invoke<&cpu::INY<Accuracy>>;
+  table[0xC9] = &invoke<&cpu::CMP<Accuracy, Immediate>>;
+  table[0xCA] = &invoke<&cpu::DEX<Accuracy>>;
+  table[0xCB] = &invoke<&cpu::AXS<Accuracy, Immediate>>;
+  table[0xCC] = &invoke<&cpu::CPY<Accuracy, Absolute>>;
+  table[0xCD] = &invoke<&cpu::CMP<Accuracy, Absolute>>;
+  table[0xCE] = &invoke<&cpu::DEC<Accuracy, Absolute>>;
+  table[0xCF] = &invoke<&cpu::DCP<Accuracy, Absolute>>;
+
+  // 0xD0 - 0xDF
+  table[0xD0] = &invoke<&cpu::BNE<Accuracy>>;
+  table[0xD1] = &invoke<&cpu::CMP<Accuracy, IndirectY>>;
+  table[0xD2] = &invoke<&cpu::JAM<Accuracy>>;
+  table[0xD3] = &invoke<&cpu::DCP<Accuracy, IndirectY>>;
+  table[0xD4] = &invoke<&cpu::NOP<Accuracy, ZeroPageX>>;
+  table[0xD5] = &invoke<&cpu::CMP<Accuracy, ZeroPageX>>;
+  table[0xD6] = &invoke<&cpu::DEC<Accuracy, ZeroPageX>>;
+  table[0xD7] = &invoke<&cpu::DCP<Accuracy, ZeroPageX>>;
+  table[0xD8] = &invoke<&cpu::CLD<Accuracy>>;
+  table[0xD9] = &invoke<&cpu::CMP<Accuracy, AbsoluteY>>;
+  table[0xDA] = &invoke<&cpu::NOP<Accuracy>>;
+  table[0xDB] = &invoke<&cpu::DCP<Accuracy, AbsoluteY>>;
+  table[0xDC] = &invoke<&cpu::NOP<Accuracy, AbsoluteX>>;
+  table[0xDD] = &invoke<&cpu::CMP<Accuracy, AbsoluteX>>;
+  table[0xDE] = &invoke<&cpu::DEC<Accuracy, AbsoluteX_Exception>>;
+  table[0xDF] = &invoke<&cpu::DCP<Accuracy, AbsoluteX>>;
+
+  // 0xE0 - 0xEF
+  table[0xE0] = &invoke<&cpu::CPX<Accuracy, Immediate>>;
+  table[0xE1] = &invoke<&cpu::SBC<Accuracy, IndirectX>>;
+  table[0xE2] = &invoke<&cpu::NOP<Accuracy, Immediate>>;
+  table[0xE3] = &invoke<&cpu::ISB<Accuracy, IndirectX>>;
+  table[0xE4] = &invoke<&cpu::CPX<Accuracy, ZeroPage>>;
+  table[0xE5] = &invoke<&cpu::SBC<Accuracy, ZeroPage>>;
+  table[0xE6] = &invoke<&cpu::INC<Accuracy, ZeroPage>>;
+  table[0xE7] = &invoke<&cpu::ISB<Accuracy, ZeroPage>>;
+  table[0xE8] = &invoke<&cpu::INX<Accuracy>>;
+  table[0xE9] = &invoke<&cpu::SBC<Accuracy, Immediate>>;
+  table[0xEA] = &invoke<&cpu::NOP<Accuracy>>;
+  table[0xEB] = &invoke<&cpu::SBC<Accuracy, Immediate>>;
+  table[0xEC] = &invoke<&cpu::CPX<Accuracy, Absolute>>;
+  table[0xED] = &invoke<&cpu::SBC<Accuracy, Absolute>>;
+  table[0xEE] = &invoke<&cpu::INC<Accuracy, Absolute>>;
+  table[0xEF] = &invoke<&cpu::ISB<Accuracy, Absolute>>;
+
+  // 0xF0 - 0xFF
+  table[0xF0] = &invoke<&cpu::BEQ<Accuracy>>;
+  table[0xF1] = &invoke<&cpu::SBC<Accuracy, IndirectY>>;
+  table[0xF2] = &invoke<&cpu::JAM<Accuracy>>;
+  table[0xF3] = &invoke<&cpu::ISB<Accuracy, IndirectY>>;
+  table[0xF4] = &invoke<&cpu::NOP<Accuracy, ZeroPageX>>;
+  table[0xF5] = &invoke<&cpu::SBC<Accuracy, ZeroPageX>>;
+  table[0xF6] = &invoke<&cpu::INC<Accuracy, ZeroPageX>>;
+  table[0xF7] = &invoke<&cpu::ISB<Accuracy, ZeroPageX>>;
+  table[0xF8] = &invoke<&cpu::SED<Accuracy>>;
+  table[0xF9] = &invoke<&cpu::SBC<Accuracy, AbsoluteY>>;
+  table[0xFA] = &invoke<&cpu::NOP<Accuracy>>;
+  table[0xFB] = &invoke<&cpu::ISB<Accuracy, AbsoluteY>>;
+  table[0xFC] = &invoke<&cpu::NOP<Accuracy, AbsoluteX>>;
+  table[0xFD] = &invoke<&cpu::SBC<Accuracy, AbsoluteX>>;
+  table[0xFE] = &invoke<&cpu::INC<Accuracy, AbsoluteX_Exception>>;
+  table[0xFF] = &invoke<&cpu::ISB<Accuracy, AbsoluteX>>;
+
+  return table;
+}
+
+namespace {
+// Cycles each opcode takes without a page crossing or a taken branch, which
+// is what the instruction accuracy charges up front
+constexpr std::array<uint8_t, 0x100> base_cycles = {
+    // 0  1  2  3  4  5  6  7  8  9  A  B  C  D  E  F
+    7, 6, 2, 8, 3, 3, 5, 5, 3, 2, 2, 2, 4, 4, 6, 6,  // 0
+    2, 5, 2, 7, 4, 4, 6, 6, 2, 4, 2, 6, 4, 4, 7, 6,  // 1
+    6, 6, 2, 8, 3, 3, 5, 5, 4, 2, 2, 2, 4, 4, 6, 6,  // 2
+    2, 5, 2, 7, 4, 4, 6, 6, 2, 4, 2, 6, 4, 4, 7, 6,  // 3
+    6, 6, 2, 8, 3, 3, 5, 5, 3, 2, 2, 2, 3, 4, 6, 6,  // 4
+    2, 5, 2, 7, 4, 4, 6, 6, 2, 4, 2, 6, 4, 4, 7, 6,  // 5
+    6, 6, 2, 8, 3, 3, 5, 5, 4, 2, 2, 2, 5, 4, 6, 6,  // 6
+    2, 5, 2, 7, 4, 4, 6, 6, 2, 4, 2, 6, 4, 4, 7, 6,  // 7
+    2, 6, 2, 6, 3, 3, 3, 3, 2, 2, 2, 2, 4, 4, 4, 4,  // 8
+    2, 6, 2, 6, 4, 4, 4, 4, 2, 5, 2, 5, 5, 5, 5, 5,  // 9
+    2, 6, 2, 6, 3, 3, 3, 3, 2, 2, 2, 2, 4, 4, 4, 4,  // A
+    2, 5, 2, 5, 4, 4, 4, 4, 2, 4, 2, 4, 4, 4, 4, 4,  // B
+    2, 6, 2, 8, 3, 3, 5, 5, 2, 2, 2, 2, 4, 4, 6, 6,  // C
+    2, 5, 2, 7, 4, 4, 6, 6, 2, 4, 2, 6, 4, 4, 7, 6,  // D
+    2, 6, 2, 8, 3, 3, 5, 5, 2, 2, 2, 2, 4, 4, 6, 6,  // E
+    2, 5, 2, 7, 4, 4, 6, 6, 2, 4, 2, 6, 4, 4, 7, 6,  // F
+};
+}  // namespace
+
+template <auto Accuracy> void cpu::execute()
+{
+  static constexpr auto table = opcode_table<Accuracy>();
+
+  if (trace) {
+    trace_instruction();
+  }
+
+  const auto opcode =
+      memory_read<Accuracy>(get_operand<Accuracy, Immediate>());
+
+  if constexpr (Accuracy == accuracy::Instruction) {
+    tick(base_cycles[opcode]);
+  }
+
+  table[opcode](*this);
+}
+
+//
+// Threaded dispatch: every opcode gets its own label and its own indirect
+// jump to the next one, which gives the branch predictor per-opcode history
+// instead of funnelling every instruction through a single jump
+//
+
+#if defined(__GNUC__) && !defined(NES_SWITCH_DISPATCH)
+
+#define NES_OPCODE_ROW(X, hi)                                              \
+  X(hi##0) X(hi##1) X(hi##2) X(hi##3) X(hi##4) X(hi##5) X(hi##6) X(hi##7) \
+  X(hi##8) X(hi##9) X(hi##A) X(hi##B) X(hi##C) X(hi##D) X(hi##E) X(hi##F)
+
+#define NES_OPCODES(X)                                                      \
+  NES_OPCODE_ROW(X, 0) NES_OPCODE_ROW(X, 1) NES_OPCODE_ROW(X, 2)            \
+  NES_OPCODE_ROW(X, 3) NES_OPCODE_ROW(X, 4) NES_OPCODE_ROW(X, 5)            \
+  NES_OPCODE_ROW(X, 6) NES_OPCODE_ROW(X, 7) NES_OPCODE_ROW(X, 8)            \
+  NES_OPCODE_ROW(X, 9) NES_OPCODE_ROW(X, A) NES_OPCODE_ROW(X, B)            \
+  NES_OPCODE_ROW(X, C) NES_OPCODE_ROW(X, D) NES_OPCODE_ROW(X, E)            \
+  NES_OPCODE_ROW(X, F)
+
+#define NES_DISPATCH()                                       \
+  if (state.cycle_count >= next_event && !handle_events<Accuracy>()) { \
+    return;                                                  \
+  }                                                          \
+  if (trace) {                                               \
+    trace_instruction();                                     \
+  }                                                          \
+  goto* labels[memory_read<Accuracy>(get_operand<Accuracy, Immediate>())]
+
+#define NES_LABEL_ADDRESS(n) &&op_##n,
+#define NES_LABEL(n)                            \
+  op_##n:                                       \
+  if constexpr (Accuracy == accuracy::Instruction) { \
+    tick(base_cycles[0x##n]);                   \
+  }                                             \
+  table[0x##n](*this);                          \
+  NES_DISPATCH();
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+
+template <auto Accuracy> void cpu::run()
+{
+  static constexpr auto table  = opcode_table<Accuracy>();
+  static void* const    labels[0x100] = {NES_OPCODES(NES_LABEL_ADDRESS)};
+
+  NES_DISPATCH();
+  NES_OPCODES(NES_LABEL)
+}
 
+#pragma GCC diagnostic pop
+
+#undef NES_LABEL
+#undef NES_LABEL_ADDRESS
+#undef NES_DISPATCH
+#undef NES_OPCODES
+#undef NES_OPCODE_ROW
+
+#else
+
+template <auto Accuracy> void cpu::run()
+{
+  while (state.cycle_count < next_event || handle_events<Accuracy>()) {
+    execute<Accuracy>();
+  }
+}
+
+#endif
+
+#ifdef NES_PROFILER
+
+//
+// Profiling. Every instruction is charged with the cycles it took, DMA stalls
+// and skipped idle iterations included. JSR, BRK and interrupts open a call
+// frame, RTS, RTI and TXS close the frames the stack pointer climbed over
+//
+
+template <auto Accuracy> void cpu::run_profiled()
+{
+  while (true) {
+    if (state.cycle_count >= next_event) {
+      const uint64_t start = state.cycle_count;
+      const uint8_t  sp    = state.sp;
+
+      if (!handle_events<Accuracy>()) {
+        return;
+      }
+
+      if (state.cycle_count != start) {
+        profiler->interrupt(
+            state.pc, bus->prg_bank(state.pc), sp, state.cycle_count - start);
+      }
+    }
+
+    const uint16_t pc     = state.pc;
+    const uint8_t  opcode = peek(pc);
+    const uint8_t  sp     = state.sp;
+    const uint64_t start  = state.cycle_count;
+
+    execute<Accuracy>();
+
+    profiler->instruction(
+        pc, bus->prg_bank(pc), opcode, state.cycle_count - start);
+
+    switch (opcode) {
+      case 0x00:  // BRK
+      case 0x20:  // JSR
+        profiler->call(state.pc, bus->prg_bank(state.pc), sp);
+        break;
+      case 0x40:  // RTI
+      case 0x60:  // RTS
+      case 0x9A:  // TXS
+        profiler->unwind(state.sp);
+        break;
+    }
+  }
+}
+
+#endif
+
+//
+// Block cache
+//
+
+namespace {
+constexpr std::array<uint8_t, 0x100> instruction_length = {
+    // 0  1  2  3  4  5  6  7  8  9  A  B  C  D  E  F
+    1, 2, 1, 2, 2, 2, 2, 2, 1, 2, 1, 2, 3, 3, 3, 3,  // 0
+    2, 2, 1, 2, 2, 2, 2, 2, 1, 3, 1, 3, 3, 3, 3, 3,  // 1
+    3, 2, 1, 2, 2, 2, 2, 2, 1, 2, 1, 2, 3, 3, 3, 3,  // 2
+    2, 2, 1, 2, 2, 2, 2, 2, 1, 3, 1, 3, 3, 3, 3, 3,  // 3
+    1, 2, 1, 2, 2, 2, 2, 2, 1, 2, 1, 2, 3, 3, 3, 3,  // 4
+    2, 2, 1, 2, 2, 2, 2, 2, 1, 3, 1, 3, 3, 3, 3, 3,  // 5
+    1, 2, 1, 2, 2, 2, 2, 2, 1, 2, 1, 2, 3, 3, 3, 3,  // 6
+    2, 2, 1, 2, 2, 2, 2, 2, 1, 3, 1, 3, 3, 3, 3, 3,  // 7
+    2, 2, 2, 2, 2, 2, 2, 2, 1, 2, 1, 2, 3, 3, 3, 3,  // 8
+    2, 2, 1, 2, 2, 2, 2, 2, 1, 3, 1, 3, 3, 3, 3, 3,  // 9
+    2, 2, 2, 2, 2, 2, 2, 2, 1, 2, 1, 2, 3, 3, 3, 3,  // A
+    2, 2, 1, 2, 2, 2, 2, 2, 1, 3, 1, 3, 3, 3, 3, 3,  // B
+    2, 2, 2, 2, 2, 2, 2, 2, 1, 2, 1, 2, 3, 3, 3, 3,  // C
+    2, 2, 1, 2, 2, 2, 2, 2, 1, 3, 1, 3, 3, 3, 3, 3,  // D
+    2, 2, 2, 2, 2, 2, 2, 2, 1, 2, 1, 2, 3, 3, 3, 3,  // E
+    2, 2, 1, 2, 2, 2, 2, 2, 1, 3, 1, 3, 3, 3, 3, 3,  // F
+};
+
+// Anything that can move the PC somewhere else ends a block
+constexpr bool ends_block(const uint8_t opcode)
+{
   switch (opcode) {
-    case 0x00: return INT_BRK();
-    case 0x01: return ORA<IndirectX>();
-    case 0x05: return ORA<ZeroPage>();
-    case 0x06: return ASL<ZeroPage>();
-    case 0x08: return PHP();
-    case 0x09: return ORA<Immediate>();
-    case 0x0A: return ASL<Accumulator>();
-    case 0x0D: return ORA<Absolute>();
-    case 0x0E: return ASL<Absolute>();
-    case 0x10: return BPL();
-    case 0x11: return ORA<IndirectY>();
-    case 0x15: return ORA<ZeroPageX>();
-    case 0x16: return ASL<ZeroPageX>();
-    case 0x18: return CLC();
-    case 0x19: return ORA<AbsoluteY>();
-    case 0x1D: return ORA<AbsoluteX>();
-    case 0x1E: return ASL<AbsoluteX_Exception>();
-    case 0x20: return JSR();
-    case 0x21: return AND<IndirectX>();
-    case 0x24: return BIT<ZeroPage>();
-    case 0x25: return AND<ZeroPage>();
-    case 0x26: return ROL<ZeroPage>();
-    case 0x28: return PLP();
-    case 0x29: return AND<Immediate>();
-    case 0x2A: return ROL<Accumulator>();
-    case 0x2C: return BIT<Absolute>();
-    case 0x2D: return AND<Absolute>();
-    case 0x2E: return ROL<Absolute>();
-    case 0x30: return BMI();
-    case 0x31: return AND<IndirectY>();
-    case 0x35: return AND<ZeroPageX>();
-    case 0x36: return ROL<ZeroPageX>();
-    case 0x38: return SEC();
-    case 0x39: return AND<AbsoluteY>();
-    case 0x3D: return AND<AbsoluteX>();
-    case 0x3E: return ROL<AbsoluteX_Exception>();
-    case 0x40: return RTI();
-    case 0x41: return EOR<IndirectX>();
-    case 0x45: return EOR<ZeroPage>();
-    case 0x46: return LSR<ZeroPage>();
-    case 0x48: return PHA();
-    case 0x49: return EOR<Immediate>();
-    case 0x4A: return LSR<Accumulator>();
-    case 0x4C: return JMP<Absolute>();
-    case 0x4D: return EOR<Absolute>();
-    case 0x4E: return LSR<Absolute>();
-    case 0x50: return BVC();
-    case 0x51: return EOR<IndirectY>();
-    case 0x55: return EOR<ZeroPageX>();
-    case 0x56: return LSR<ZeroPageX>();
-    case 0x58: return CLI();
-    case 0x59: return EOR<AbsoluteY>();
-    case 0x5D: return EOR<AbsoluteX>();
-    case 0x5E: return LSR<AbsoluteX_Exception>();
-    case 0x60: return RTS();
-    case 0x61: return ADC<IndirectX>();
-    case 0x65: return ADC<ZeroPage>();
-    case 0x66: return ROR<ZeroPage>();
-    case 0x68: return PLA();
-    case 0x69: return ADC<Immediate>();
-    case 0x6A: return ROR<Accumulator>();
-    case 0x6C: return JMP<Indirect>();
-    case 0x6D: return ADC<Absolute>();
-    case 0x6E: return ROR<Absolute>();
-    case 0x70: return BVS();
-    case 0x71: return ADC<IndirectY>();
-    case 0x75: return ADC<ZeroPageX>();
-    case 0x76: return ROR<ZeroPageX>();
-    case 0x78: return SEI();
-    case 0x79: return ADC<AbsoluteY>();
-    case 0x7D: return ADC<AbsoluteX>();
-    case 0x7E: return ROR<AbsoluteX_Exception>();
-    case 0x81: return STA<IndirectX>();
-    case 0x84: return STY<ZeroPage>();
-    case 0x85: return STA<ZeroPage>();
-    case 0x86: return STX<ZeroPage>();
-    case 0x88: return DEY();
-    case 0x8A: return TXA();
-    case 0x8C: return STY<Absolute>();
-    case 0x8D: return STA<Absolute>();
-    case 0x8E: return STX<Absolute>();
-    case 0x90: return BCC();
-    case 0x91: return STA<IndirectY_Exception>();
-    case 0x94: return STY<ZeroPageX>();
-    case 0x95: return STA<ZeroPageX>();
-    case 0x96: return STX<ZeroPageY>();
-    case 0x98: return TYA();
-    case 0x99: return STA<AbsoluteY_Exception>();
-    case 0x9A: return TXS();
-    case 0x9D: return STA<AbsoluteX_Exception>();
-    case 0xA0: return LDY<Immediate>();
-    case 0xA1: return LDA<IndirectX>();
-    case 0xA2: return LDX<Immediate>();
-    case 0xA4: return LDY<ZeroPage>();
-    case 0xA5: return LDA<ZeroPage>();
-    case 0xA6: return LDX<ZeroPage>();
-    case 0xA8: return TAY();
-    case 0xA9: return LDA<Immediate>();
-    case 0xAA: return TAX();
-    case 0xAC: return LDY<Absolute>();
-    case 0xAD: return LDA<Absolute>();
-    case 0xAE: return LDX<Absolute>();
-    case 0xB0: return BCS();
-    case 0xB1: return LDA<IndirectY>();
-    case 0xB4: return LDY<ZeroPageX>();
-    case 0xB5: return LDA<ZeroPageX>();
-    case 0xB6: return LDX<ZeroPageY>();
-    case 0xB8: return CLV();
-    case 0xB9: return LDA<AbsoluteY>();
-    case 0xBA: return TSX();
-    case 0xBC: return LDY<AbsoluteX>();
-    case 0xBD: return LDA<AbsoluteX>();
-    case 0xBE: return LDX<AbsoluteY>();
-    case 0xC0: return CPY<Immediate>();
-    case 0xC1: return CMP<IndirectX>();
-    case 0xC4: return CPY<ZeroPage>();
-    case 0xC5: return CMP<ZeroPage>();
-    case 0xC6: return DEC<ZeroPage>();
-    case 0xC8: return INY();
-    case 0xC9: return CMP<Immediate>();
-    case 0xCA: return DEX();
-    case 0xCC: return CPY<Absolute>();
-    case 0xCD: return CMP<Absolute>();
-    case 0xCE: return DEC<Absolute>();
-    case 0xD0: return BNE();
-    case 0xD1: return CMP<IndirectY>();
-    case 0xD5: return CMP<ZeroPageX>();
-    case 0xD6: return DEC<ZeroPageX>();
-    case 0xD8: return CLD();
-    case 0xD9: return CMP<AbsoluteY>();
-    case 0xDD: return CMP<AbsoluteX>();
-    case 0xDE: return DEC<AbsoluteX_Exception>();
-    case 0xE0: return CPX<Immediate>();
-    case 0xE1: return SBC<IndirectX>();
-    case 0xE4: return CPX<ZeroPage>();
-    case 0xE5: return SBC<ZeroPage>();
-    case 0xE6: return INC<ZeroPage>();
-    case 0xE8: return INX();
-    case 0xE9: return SBC<Immediate>();
-    case 0xEA: return NOP();
-    case 0xEC: return CPX<Absolute>();
-    case 0xED: return SBC<Absolute>();
-    case 0xEE: return INC<Absolute>();
-    case 0xF0: return BEQ();
-    case 0xF1: return SBC<IndirectY>();
-    case 0xF5: return SBC<ZeroPageX>();
-    case 0xF6: return INC<ZeroPageX>();
-    case 0xF8: return SED();
-    case 0xF9: return SBC<AbsoluteY>();
-    case 0xFD: return SBC<AbsoluteX>();
-    case 0xFE: return INC<AbsoluteX_Exception>();
-
-    //
-    // Unofficial instructions
-    //
-
-    // NOP
-    case 0x04:
-    case 0x44:
-    case 0x64: return NOP<ZeroPage>();
-    case 0x0C: return NOP<Absolute>();
-    case 0x14:
-    case 0x34:
-    case 0x54:
-    case 0x74:
-    case 0xD4:
-    case 0xF4: return NOP<ZeroPageX>();
-    case 0x1A:
-    case 0x3A:
-    case 0x5A:
-    case 0x7A:
-    case 0xDA:
-    case 0xFA: return NOP();
-    case 0x80: return NOP<Immediate>();
-    case 0x1C:
-    case 0x3C:
-    case 0x5C:
-    case 0x7C:
-    case 0xDC:
-    case 0xFC: return NOP<AbsoluteX>();
-
-    // LAX
-    case 0xA3: return LAX<IndirectX>();
-    case 0xA7: return LAX<ZeroPage>();
-    case 0xAF: return LAX<Absolute>();
-    case 0xB3: return LAX<IndirectY>();
-    case 0xB7: return LAX<ZeroPageY>();
-    case 0xBF: return LAX<AbsoluteY>();
-
-    // SAX
-    case 0x83: return SAX<IndirectX>();
-    case 0x87: return SAX<ZeroPage>();
-    case 0x8F: return SAX<Absolute>();
-    case 0x97: return SAX<ZeroPageY>();
-
-    // SBC
-    case 0xEB: return SBC<Immediate>();
-
-    // DCP
-    case 0xC3: return DCP<IndirectX>();
-    case 0xC7: return DCP<ZeroPage>();
-    case 0xCF: return DCP<Absolute>();
-    case 0xD3: return DCP<IndirectY>();
-    case 0xD7: return DCP<ZeroPageX>();
-    case 0xDB: return DCP<AbsoluteY>();
-    case 0xDF: return DCP<AbsoluteX>();
-
-    // ISB
-    case 0xE3: return ISB<IndirectX>();
-    case 0xE7: return ISB<ZeroPage>();
-    case 0xEF: return ISB<Absolute>();
-    case 0xF3: return ISB<IndirectY>();
-    case 0xF7: return ISB<ZeroPageX>();
-    case 0xFB: return ISB<AbsoluteY>();
-    case 0xFF: return ISB<AbsoluteX>();
-
-    // SLO
-    case 0x03: return SLO<IndirectX>();
-    case 0x07: return SLO<ZeroPage>();
-    case 0x0F: return SLO<Absolute>();
-    case 0x13: return SLO<IndirectY>();
-    case 0x17: return SLO<ZeroPageX>();
-    case 0x1B: return SLO<AbsoluteY>();
-    case 0x1F: return SLO<AbsoluteX>();
-
-    // RLA
-    case 0x23: return RLA<IndirectX>();
-    case 0x27: return RLA<ZeroPage>();
-    case 0x2F: return RLA<Absolute>();
-    case 0x33: return RLA<IndirectY>();
-    case 0x37: return RLA<ZeroPageX>();
-    case 0x3B: return RLA<AbsoluteY>();
-    case 0x3F: return RLA<AbsoluteX>();
-
-    // SRE
-    case 0x43: return SRE<IndirectX>();
-    case 0x47: return SRE<ZeroPage>();
-    case 0x4F: return SRE<Absolute>();
-    case 0x53: return SRE<IndirectY>();
-    case 0x57: return SRE<ZeroPageX>();
-    case 0x5B: return SRE<AbsoluteY>();
-    case 0x5F: return SRE<AbsoluteX>();
-
-    // RRA
-    case 0x63: return RRA<IndirectX>();
-    case 0x67: return RRA<ZeroPage>();
-    case 0x6F: return RRA<Absolute>();
-    case 0x73: return RRA<IndirectY>();
-    case 0x77: return RRA<ZeroPageX>();
-    case 0x7B: return RRA<AbsoluteY>();
-    case 0x7F: return RRA<AbsoluteX>();
-
-    default: {
-      LOG(log::Error) << "Invalid opcode: " << +opcode;
-      throw std::runtime_error("Invalid opcode");
-      return;
+    case 0x00:  // BRK
+    case 0x20:  // JSR
+    case 0x40:  // RTI
+    case 0x4C:  // JMP
+    case 0x60:  // RTS
+    case 0x6C:  // JMP
+    case 0x10:
+    case 0x30:
+    case 0x50:
+    case 0x70:
+    case 0x90:
+    case 0xB0:
+    case 0xD0:
+    case 0xF0: return true;  // Branches
+    case 0x02:
+    case 0x12:
+    case 0x22:
+    case 0x32:
+    case 0x42:
+    case 0x52:
+    case 0x62:
+    case 0x72:
+    case 0x92:
+    case 0xB2:
+    case 0xD2:
+    case 0xF2: return true;  // JAM
+    default: return false;
+  }
+}
+}  // namespace
+
+template <auto Accuracy> void cpu::run_cached()
+{
+  while (state.cycle_count < next_event || handle_events<Accuracy>()) {
+    const auto* entry = find_block<Accuracy>(state.pc);
+
+    if (!entry) {
+      // Code outside of host memory (I/O space) can't be cached
+      execute<Accuracy>();
+      continue;
+    }
+
+    code_modified = false;
+
+    while (true) {
+      // Copied, running it may throw the block away
+      const block_entry current = *entry;
+
+      if (trace) {
+        trace_instruction();
+      }
+
+      tick<Accuracy>();  // Opcode fetch
+      ++state.pc;
+
+      if constexpr (Accuracy == accuracy::Instruction) {
+        tick(base_cycles[current.opcode]);
+      }
+
+      operands = current.split ? nullptr : current.operands.data();
+      current.handler(*this);
+      operands = nullptr;
+
+      if (current.last || interrupted()) {
+        break;
+      }
+
+      ++entry;
     }
   }
 }
 
+// True when the CPU has to leave the current block before the next opcode
+bool cpu::interrupted() const
+{
+  return state.cycle_count >= next_event || code_modified;
+}
+
+template <auto Accuracy>
+const cpu::block_entry* cpu::find_block(const uint16_t addr)
+{
+  auto& page = pages[addr >> 8];
+
+  if (!page.read) {
+    return nullptr;
+  }
+
+  if (!page.code) {
+    const auto [it, inserted] = code_cache.try_emplace(page.read);
+
+    if (inserted) {
+      it->second.block_at.fill(no_block);
+    }
+
+    page.code = &it->second;
+  }
+
+  auto& code   = *page.code;
+  auto  offset = static_cast<uint8_t>(addr & 0xFF);
+
+  if (code.block_at[offset] == no_block) {
+    code.block_at[offset] = decode_block<Accuracy>(code, page.read, offset);
+
+    if (page.write || page.code_write) {
+      protect_code(page.read);
+    }
+  }
+
+  return &code.entries[code.block_at[offset]];
+}
+
+// Decodes from the given offset up to the first control flow instruction or
+// the end of the page, whichever comes first
+template <auto Accuracy>
+uint16_t cpu::decode_block(
+    code_page&     code,
+    const uint8_t* host,
+    const uint8_t  offset)
+{
+  static constexpr auto table = opcode_table<Accuracy>();
+
+  const auto first = static_cast<uint16_t>(code.entries.size());
+
+  size_t addr = offset;
+
+  while (true) {
+    const auto opcode = host[addr];
+    const auto length = instruction_length[opcode];
+
+    block_entry entry{table[opcode], opcode, false, addr + length > 0x100, {}};
+
+    for (size_t i = 1; i < length && !entry.split; ++i) {
+      entry.operands[i - 1] = host[addr + i];
+    }
+
+    code.entries.push_back(entry);
+    addr += length;
+
+    if (ends_block(opcode) || addr >= 0x100) {
+      break;
+    }
+  }
+
+  code.entries.back().last = true;
+
+  return first;
+}
+
+//
+// Idle loops
+//
+
+namespace {
+constexpr uint16_t max_idle_body = 0x20;
+
+// Instructions that neither write memory nor touch the stack or the I flag,
+// in addressing modes whose address doesn't depend on the registers
+constexpr std::array<bool, 0x100> idle_opcode = {
+    // 0  1  2  3  4  5  6  7  8  9  A  B  C  D  E  F
+    0, 0, 0, 0, 0, 1, 0, 0, 0, 1, 1, 0, 0, 1, 0, 0,  // 0
+    1, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0,  // 1
+    0, 0, 0, 0, 1, 1, 0, 0, 0, 1, 1, 0, 1, 1, 0, 0,  // 2
+    1, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0,  // 3
+    0, 0, 0, 0, 0, 1, 0, 0, 0, 1, 1, 0, 1, 1, 0, 0,  // 4
+    1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  // 5
+    0, 0, 0, 0, 0, 1, 0, 0, 0, 1, 1, 0, 0, 1, 0, 0,  // 6
+    1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  // 7
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 1, 0, 0, 0, 0, 0,  // 8
+    1, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0,  // 9
+    1, 0, 1, 0, 1, 1, 1, 0, 1, 1, 1, 0, 1, 1, 1, 0,  // A
+    1, 0, 0, 0, 0, 0, 0, 0, 1, 0, 1, 0, 0, 0, 0, 0,  // B
+    1, 0, 0, 0, 1, 1, 0, 0, 1, 1, 1, 0, 1, 1, 0, 0,  // C
+    1, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0,  // D
+    1, 0, 0, 0, 1, 1, 0, 0, 1, 1, 1, 0, 1, 1, 0, 0,  // E
+    1, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0,  // F
+};
+
+constexpr bool is_branch(const uint8_t opcode)
+{
+  return (opcode & 0x1F) == 0x10;
+}
+}  // namespace
+
+// Called when a branch or JMP at the given address has just jumped backwards.
+// The first time round only the body is checked. After that, two arrivals
+// in a row with the same registers and no deadline in between prove that
+// every iteration up to the next deadline is identical to the last one
+void cpu::loop_back(const uint16_t from)
+{
+  if (!idle_skip) {
+    return;
+  }
+
+  if (!idle.active || idle.head != state.pc || idle.branch != from ||
+      idle.deadline != next_event) {
+    idle          = {};
+    idle.active   = true;
+    idle.head     = state.pc;
+    idle.branch   = from;
+    idle.deadline = next_event;
+    idle.pure     = idle_body(state.pc, from);
+  } else if (!idle.pure) {
+    return;
+  } else if (
+      ++idle.iterations >= 2 && idle.a == state.a && idle.x == state.x &&
+      idle.y == state.y && idle.sp == state.sp && idle.ps == state.ps() &&
+      state.cycle_count < next_event) {
+    // The first iteration isn't compared, a PPUSTATUS read in it may still
+    // have cleared the vblank flag. A pending interrupt has already pulled
+    // next_event in
+    const auto length = state.cycle_count - idle.cycle;
+    const auto count  = (next_event - state.cycle_count) / length;
+
+    tick(static_cast<int>(count * length));
+  }
+
+  idle.a     = state.a;
+  idle.x     = state.x;
+  idle.y     = state.y;
+  idle.sp    = state.sp;
+  idle.ps    = state.ps();
+  idle.cycle = state.cycle_count;
+}
+
+// True when everything between the loop head and the backward jump at the
+// given address reads only RAM, ROM or PPUSTATUS, and any branch inside the
+// body stays inside it. Exiting is then only possible through the backward
+// jump itself
+bool cpu::idle_body(const uint16_t head, const uint16_t end) const
+{
+  if (end < head || end - head > max_idle_body || !pages[head >> 8].read ||
+      !pages[(end + 2) >> 8].read) {
+    return false;
+  }
+
+  const auto inside = [head, end](const uint16_t target) {
+    return target >= head && target <= end;
+  };
+
+  const auto quiet = [this](const uint16_t addr) {
+    return pages[addr >> 8].read != nullptr ||
+           (addr >= 0x2000 && addr < 0x4000 && (addr & 7) == 2);
+  };
+
+  uint16_t addr = head;
+
+  while (addr < end) {
+    const auto opcode = peek(addr);
+
+    if (!idle_opcode[opcode]) {
+      return false;
+    }
+
+    const uint16_t next    = addr + instruction_length[opcode];
+    const uint16_t operand = peek(addr + 1) | (peek(addr + 2) << 8);
+
+    if (is_branch(opcode)) {
+      if (!inside(next + static_cast<int8_t>(operand & 0xFF))) {
+        return false;
+      }
+    } else if (opcode == 0x4C) {
+      if (!inside(operand)) {
+        return false;
+      }
+    } else if (instruction_length[opcode] == 3 && !quiet(operand)) {
+      return false;
+    }
+
+    addr = next;
+  }
+
+  return addr == end;
+}
+
 /* Instructions */
 
 //
 // Auxiliary functions
 //
 
+// One bus cycle. The instruction accuracy has already charged them all
+template <auto Accuracy> void cpu::tick()
+{
+  if constexpr (Accuracy == accuracy::Cycle) {
+    ++state.cycle_count;
+  }
+}
+
+// Cycles that are charged with either accuracy
+void cpu::tick(const int cycles)
+{
+  state.cycle_count += cycles;
+}
+
+template <auto Accuracy> uint8_t cpu::memory_read(const uint16_t addr)
+{
+  tick<Accuracy>();
+  return this->read(addr);
+}
+
+template <auto Accuracy>
+void cpu::memory_write(const uint16_t addr, const uint8_t value)
+{
+  tick<Accuracy>();
+  this->write(addr, value);
+}
+
 void cpu::add(const uint8_t value)
 {
   const uint16_t result = state.a + value + state.check_flags(flags::Carry);
@@ -378,32 +893,39 @@ void cpu::compare(const uint8_t reg, const uint8_t value)
   }
 }
 
-void cpu::branch(const bool taken)
+template <auto Accuracy> void cpu::branch(const bool taken)
 {
-  const auto addr   = get_operand<Relative>();
-  const auto offset = static_cast<int8_t>(memory_read(addr));
+  const auto offset = static_cast<int8_t>(fetch<Accuracy>());
 
+  // Taking the branch costs its extra cycles with either accuracy
   if (taken) {
     if (crosses_page(state.pc, offset)) {
-      tick();
+      tick(1);
     }
 
-    tick();
+    tick(1);
 
     this->state.pc += offset;
+
+    if (offset < -1) {
+      loop_back(state.pc - offset - 2);
+    }
+  } else if (static_cast<uint16_t>(state.pc - 2) == idle.branch) {
+    // Fell out of the loop
+    idle.active = false;
   }
 }
 
-void cpu::push(const uint8_t value)
+template <auto Accuracy> void cpu::push(const uint8_t value)
 {
-  memory_write(0x100 + state.sp, value);
+  memory_write<Accuracy>(0x100 + state.sp, value);
   --state.sp;
 }
 
-uint8_t cpu::pop()
+template <auto Accuracy> uint8_t cpu::pop()
 {
   ++state.sp;
-  return memory_read(0x100 + state.sp);
+  return memory_read<Accuracy>(0x100 + state.sp);
 }
 
 bool cpu::crosses_page(const uint16_t addr, const uint8_t i) const
@@ -420,166 +942,161 @@ bool cpu::crosses_page(const uint16_t addr, const int8_t i) const
 // Storage
 //
 
-template <auto Mode> void cpu::LDA()
+template <auto Accuracy, auto Mode> void cpu::LDA()
 {
-  const auto addr  = get_operand<Mode>();
-  const auto value = memory_read(addr);
+  const auto value = read_operand<Accuracy, Mode>();
 
   state.set_a(value);
 }
 
-template <auto Mode> void cpu::LDX()
+template <auto Accuracy, auto Mode> void cpu::LDX()
 {
-  const auto addr  = get_operand<Mode>();
-  const auto value = memory_read(addr);
+  const auto value = read_operand<Accuracy, Mode>();
 
   state.set_x(value);
 }
 
-template <auto Mode> void cpu::LDY()
+template <auto Accuracy, auto Mode> void cpu::LDY()
 {
-  const auto addr  = get_operand<Mode>();
-  const auto value = memory_read(addr);
+  const auto value = read_operand<Accuracy, Mode>();
 
   state.set_y(value);
 }
 
-template <auto Mode> void cpu::STA()
+template <auto Accuracy, auto Mode> void cpu::STA()
 {
-  const auto addr = get_operand<Mode>();
+  const auto addr = get_operand<Accuracy, Mode>();
 
   if constexpr (
       Mode == AbsoluteX_Exception || Mode == AbsoluteY_Exception ||
       Mode == IndirectY_Exception) {
-    tick();
+    tick<Accuracy>();
   }
 
-  memory_write(addr, state.a);
+  memory_write<Accuracy>(addr, state.a);
 }
 
-template <auto Mode> void cpu::STX()
+template <auto Accuracy, auto Mode> void cpu::STX()
 {
-  const auto addr = get_operand<Mode>();
+  const auto addr = get_operand<Accuracy, Mode>();
 
-  memory_write(addr, state.x);
+  memory_write<Accuracy>(addr, state.x);
 }
 
-template <auto Mode> void cpu::STY()
+template <auto Accuracy, auto Mode> void cpu::STY()
 {
-  const auto addr = get_operand<Mode>();
+  const auto addr = get_operand<Accuracy, Mode>();
 
-  memory_write(addr, state.y);
+  memory_write<Accuracy>(addr, state.y);
 }
 
-void cpu::TAX()
+template <auto Accuracy> void cpu::TAX()
 {
   state.set_x(state.a);
-  tick();
+  tick<Accuracy>();
 }
 
-void cpu::TAY()
+template <auto Accuracy> void cpu::TAY()
 {
   state.set_y(state.a);
-  tick();
+  tick<Accuracy>();
 }
 
-void cpu::TSX()
+template <auto Accuracy> void cpu::TSX()
 {
   state.set_x(state.sp);
-  tick();
+  tick<Accuracy>();
 }
 
-void cpu::TXA()
+template <auto Accuracy> void cpu::TXA()
 {
   state.set_a(state.x);
-  tick();
+  tick<Accuracy>();
 }
 
-void cpu::TXS()
+template <auto Accuracy> void cpu::TXS()
 {
   state.sp = state.x;
-  tick();
+  tick<Accuracy>();
 }
 
-void cpu::TYA()
+template <auto Accuracy> void cpu::TYA()
 {
   state.set_a(state.y);
-  tick();
+  tick<Accuracy>();
 }
 
 //
 // Math
 //
 
-template <auto Mode> void cpu::ADC()
+template <auto Accuracy, auto Mode> void cpu::ADC()
 {
-  const auto addr  = get_operand<Mode>();
-  const auto value = memory_read(addr);
+  const auto value = read_operand<Accuracy, Mode>();
 
   this->add(value);
 }
 
-template <auto Mode> void cpu::SBC()
+template <auto Accuracy, auto Mode> void cpu::SBC()
 {
-  const auto addr  = get_operand<Mode>();
-  const auto value = memory_read(addr);
+  const auto value = read_operand<Accuracy, Mode>();
 
   this->add(value ^ 0xFF);
 }
 
-template <auto Mode> void cpu::INC()
+template <auto Accuracy, auto Mode> void cpu::INC()
 {
-  const auto addr  = get_operand<Mode>();
-  const auto value = memory_read(addr);
+  const auto addr  = get_operand<Accuracy, Mode>();
+  const auto value = memory_read<Accuracy>(addr);
 
   if constexpr (Mode == AbsoluteX_Exception) {
-    tick();
+    tick<Accuracy>();
   }
 
   const uint8_t result = value + 1;
   state.update_nz(result);
 
-  tick();
-  memory_write(addr, result);
+  tick<Accuracy>();
+  memory_write<Accuracy>(addr, result);
 }
 
-template <auto Mode> void cpu::DEC()
+template <auto Accuracy, auto Mode> void cpu::DEC()
 {
-  const auto addr  = get_operand<Mode>();
-  const auto value = memory_read(addr);
+  const auto addr  = get_operand<Accuracy, Mode>();
+  const auto value = memory_read<Accuracy>(addr);
 
   if constexpr (Mode == AbsoluteX_Exception) {
-    tick();
+    tick<Accuracy>();
   }
 
   const uint8_t result = value - 1;
   state.update_nz(result);
 
-  tick();
-  memory_write(addr, result);
+  tick<Accuracy>();
+  memory_write<Accuracy>(addr, result);
 }
 
-void cpu::INX()
+template <auto Accuracy> void cpu::INX()
 {
-  tick();
+  tick<Accuracy>();
   state.set_x(state.x + 1);
 }
 
-void cpu::INY()
+template <auto Accuracy> void cpu::INY()
 {
-  tick();
+  tick<Accuracy>();
   state.set_y(state.y + 1);
 }
 
-void cpu::DEX()
+template <auto Accuracy> void cpu::DEX()
 {
-  tick();
+  tick<Accuracy>();
   state.set_x(state.x - 1);
 }
 
-void cpu::DEY()
+template <auto Accuracy> void cpu::DEY()
 {
-  tick();
+  tick<Accuracy>();
   state.set_y(state.y - 1);
 }
 
@@ -587,99 +1104,96 @@ void cpu::DEY()
 // Bitwise
 //
 
-template <auto Mode> void cpu::AND()
+template <auto Accuracy, auto Mode> void cpu::AND()
 {
-  const auto addr  = get_operand<Mode>();
-  const auto value = memory_read(addr);
+  const auto value = read_operand<Accuracy, Mode>();
 
   state.set_a(state.a & value);
 }
 
-template <auto Mode> void cpu::ORA()
+template <auto Accuracy, auto Mode> void cpu::ORA()
 {
-  const auto addr  = get_operand<Mode>();
-  const auto value = memory_read(addr);
+  const auto value = read_operand<Accuracy, Mode>();
 
   state.set_a(state.a | value);
 }
 
-template <auto Mode> void cpu::EOR()
+template <auto Accuracy, auto Mode> void cpu::EOR()
 {
-  const auto addr  = get_operand<Mode>();
-  const auto value = memory_read(addr);
+  const auto value = read_operand<Accuracy, Mode>();
 
   state.set_a(state.a ^ value);
 }
 
-template <auto Mode> void cpu::LSR()
+template <auto Accuracy, auto Mode> void cpu::LSR()
 {
   if constexpr (Mode == Accumulator) {
-    tick();
+    tick<Accuracy>();
     state.set_a(shift_right(state.a));
   } else {
-    const auto addr  = get_operand<Mode>();
-    const auto value = memory_read(addr);
+    const auto addr  = get_operand<Accuracy, Mode>();
+    const auto value = memory_read<Accuracy>(addr);
 
     if constexpr (Mode == AbsoluteX_Exception) {
-      tick();
+      tick<Accuracy>();
     }
 
-    tick();
-    memory_write(addr, shift_right(value));
+    tick<Accuracy>();
+    memory_write<Accuracy>(addr, shift_right(value));
   }
 }
 
-template <auto Mode> void cpu::ASL()
+template <auto Accuracy, auto Mode> void cpu::ASL()
 {
   if constexpr (Mode == Accumulator) {
-    tick();
+    tick<Accuracy>();
     state.set_a(shift_left(state.a));
   } else {
-    const auto addr  = get_operand<Mode>();
-    const auto value = memory_read(addr);
+    const auto addr  = get_operand<Accuracy, Mode>();
+    const auto value = memory_read<Accuracy>(addr);
 
     if constexpr (Mode == AbsoluteX_Exception) {
-      tick();
+      tick<Accuracy>();
     }
 
-    tick();
-    memory_write(addr, shift_left(value));
+    tick<Accuracy>();
+    memory_write<Accuracy>(addr, shift_left(value));
   }
 }
 
-template <auto Mode> void cpu::ROL()
+template <auto Accuracy, auto Mode> void cpu::ROL()
 {
   if constexpr (Mode == Accumulator) {
-    tick();
+    tick<Accuracy>();
     state.set_a(rotate_left(state.a));
   } else {
-    const auto addr  = get_operand<Mode>();
-    const auto value = memory_read(addr);
+    const auto addr  = get_operand<Accuracy, Mode>();
+    const auto value = memory_read<Accuracy>(addr);
 
     if constexpr (Mode == AbsoluteX_Exception) {
-      tick();
+      tick<Accuracy>();
     }
 
-    tick();
-    memory_write(addr, rotate_left(value));
+    tick<Accuracy>();
+    memory_write<Accuracy>(addr, rotate_left(value));
   }
 }
 
-template <auto Mode> void cpu::ROR()
+template <auto Accuracy, auto Mode> void cpu::ROR()
 {
   if constexpr (Mode == Accumulator) {
-    tick();
+    tick<Accuracy>();
     state.set_a(rotate_right(state.a));
   } else {
-    const auto addr  = get_operand<Mode>();
-    const auto value = memory_read(addr);
+    const auto addr  = get_operand<Accuracy, Mode>();
+    const auto value = memory_read<Accuracy>(addr);
 
     if constexpr (Mode == AbsoluteX_Exception) {
-      tick();
+      tick<Accuracy>();
     }
 
-    tick();
-    memory_write(addr, rotate_right(value));
+    tick<Accuracy>();
+    memory_write<Accuracy>(addr, rotate_right(value));
   }
 }
 
@@ -687,299 +1201,317 @@ template <auto Mode> void cpu::ROR()
 // Flags
 //
 
-void cpu::CLC()
+template <auto Accuracy> void cpu::CLC()
 {
-  tick();
+  tick<Accuracy>();
   state.clear_flags(flags::Carry);
 }
 
-void cpu::CLD()
+template <auto Accuracy> void cpu::CLD()
 {
-  tick();
+  tick<Accuracy>();
   state.clear_flags(flags::Decimal);
 }
 
-void cpu::CLI()
+template <auto Accuracy> void cpu::CLI()
 {
-  tick();
+  tick<Accuracy>();
   state.clear_flags(flags::Interrupt);
+  recheck_interrupts();
 }
 
-void cpu::CLV()
+template <auto Accuracy> void cpu::CLV()
 {
-  tick();
+  tick<Accuracy>();
   state.clear_flags(flags::Overflow);
 }
 
-void cpu::SEC()
+template <auto Accuracy> void cpu::SEC()
 {
-  tick();
+  tick<Accuracy>();
   state.set_flags(flags::Carry);
 }
 
-void cpu::SED()
+template <auto Accuracy> void cpu::SED()
 {
-  tick();
+  tick<Accuracy>();
   state.set_flags(flags::Decimal);
 }
 
-void cpu::SEI()
+template <auto Accuracy> void cpu::SEI()
 {
-  tick();
+  tick<Accuracy>();
   state.set_flags(flags::Interrupt);
 }
 
-template <auto Mode> void cpu::CMP()
+template <auto Accuracy, auto Mode> void cpu::CMP()
 {
-  const auto addr  = get_operand<Mode>();
-  const auto value = memory_read(addr);
+  const auto value = read_operand<Accuracy, Mode>();
 
   compare(state.a, value);
 }
 
-template <auto Mode> void cpu::CPX()
+template <auto Accuracy, auto Mode> void cpu::CPX()
 {
-  const auto addr  = get_operand<Mode>();
-  const auto value = memory_read(addr);
+  const auto value = read_operand<Accuracy, Mode>();
 
   compare(state.x, value);
 }
 
-template <auto Mode> void cpu::CPY()
+template <auto Accuracy, auto Mode> void cpu::CPY()
 {
-  const auto addr  = get_operand<Mode>();
-  const auto value = memory_read(addr);
+  const auto value = read_operand<Accuracy, Mode>();
 
   compare(state.y, value);
 }
 
-template <auto Mode> void cpu::BIT()
+template <auto Accuracy, auto Mode> void cpu::BIT()
 {
-  const auto addr  = get_operand<Mode>();
-  const auto value = memory_read(addr);
+  const auto value = read_operand<Accuracy, Mode>();
 
-  state.clear_flags(flags::Zero | flags::Overflow | flags::Negative);
-
-  if (!(state.a & value)) {
-    state.set_flags(flags::Zero);
-  }
+  state.clear_flags(flags::Overflow);
 
   if (value & 0x40) {
     state.set_flags(flags::Overflow);
   }
 
-  if (value & 0x80) {
-    state.set_flags(flags::Negative);
-  }
+  state.update_nz(value, state.a & value);
 }
 
 //
 // Jumps and branches
 //
 
-template <auto Mode> void cpu::JMP()
+template <auto Accuracy, auto Mode> void cpu::JMP()
 {
-  state.set_pc(get_operand<Mode>());
+  const uint16_t from = state.pc - 1;
+
+  state.set_pc(get_operand<Accuracy, Mode>());
+
+  if constexpr (Mode == Absolute) {
+    if (state.pc <= from) {
+      loop_back(from);
+    }
+  }
 }
 
-void cpu::JSR()
+template <auto Accuracy> void cpu::JSR()
 {
-  tick();
-  push(static_cast<uint8_t>((state.pc + 1) >> 8));
-  push(static_cast<uint8_t>(state.pc + 1));
+  tick<Accuracy>();
+  push<Accuracy>(static_cast<uint8_t>((state.pc + 1) >> 8));
+  push<Accuracy>(static_cast<uint8_t>(state.pc + 1));
 
-  state.set_pc(get_operand<Absolute>());
+  state.set_pc(get_operand<Accuracy, Absolute>());
 }
 
-void cpu::BCC()
+template <auto Accuracy> void cpu::BCC()
 {
-  branch(state.check_flags(flags::Carry) == false);
+  branch<Accuracy>(state.check_flags(flags::Carry) == false);
 }
 
-void cpu::BCS()
+template <auto Accuracy> void cpu::BCS()
 {
-  branch(state.check_flags(flags::Carry) == true);
+  branch<Accuracy>(state.check_flags(flags::Carry) == true);
 }
 
-void cpu::BEQ()
+template <auto Accuracy> void cpu::BEQ()
 {
-  branch(state.check_flags(flags::Zero) == true);
+  branch<Accuracy>(state.check_flags(flags::Zero) == true);
 }
 
-void cpu::BMI()
+template <auto Accuracy> void cpu::BMI()
 {
-  branch(state.check_flags(flags::Negative) == true);
+  branch<Accuracy>(state.check_flags(flags::Negative) == true);
 }
 
-void cpu::BNE()
+template <auto Accuracy> void cpu::BNE()
 {
-  branch(state.check_flags(flags::Zero) == false);
+  branch<Accuracy>(state.check_flags(flags::Zero) == false);
 }
 
-void cpu::BPL()
+template <auto Accuracy> void cpu::BPL()
 {
-  branch(state.check_flags(flags::Negative) == false);
+  branch<Accuracy>(state.check_flags(flags::Negative) == false);
 }
 
-void cpu::BVC()
+template <auto Accuracy> void cpu::BVC()
 {
-  branch(state.check_flags(flags::Overflow) == false);
+  branch<Accuracy>(state.check_flags(flags::Overflow) == false);
 }
 
-void cpu::BVS()
+template <auto Accuracy> void cpu::BVS()
 {
-  branch(state.check_flags(flags::Overflow) == true);
+  branch<Accuracy>(state.check_flags(flags::Overflow) == true);
 }
 
-void cpu::RTS()
+template <auto Accuracy> void cpu::RTS()
 {
-  tick();
-  tick();
-  tick();
-  state.set_pc((pop() | (pop() << 8)) + 1);
+  tick<Accuracy>();
+  tick<Accuracy>();
+  tick<Accuracy>();
+  state.set_pc((pop<Accuracy>() | (pop<Accuracy>() << 8)) + 1);
 }
 
-void cpu::RTI()
+template <auto Accuracy> void cpu::RTI()
 {
-  tick();
-  tick();
-  state.set_ps(pop());
-  state.set_pc(pop() | (pop() << 8));
+  tick<Accuracy>();
+  tick<Accuracy>();
+  state.set_ps(pop<Accuracy>());
+  state.set_pc(pop<Accuracy>() | (pop<Accuracy>() << 8));
+  recheck_interrupts();
 }
 
 //
 // Stack
 //
 
-void cpu::PHA()
+template <auto Accuracy> void cpu::PHA()
 {
-  tick();
-  push(state.a);
+  tick<Accuracy>();
+  push<Accuracy>(state.a);
 }
 
-void cpu::PLA()
+template <auto Accuracy> void cpu::PLA()
 {
-  tick();
-  tick();
-  state.set_a(pop());
+  tick<Accuracy>();
+  tick<Accuracy>();
+  state.set_a(pop<Accuracy>());
 }
 
-void cpu::PHP()
+template <auto Accuracy> void cpu::PHP()
 {
-  tick();
-  push(state.ps | flags::Break | flags::Reserved);
+  tick<Accuracy>();
+  push<Accuracy>(state.ps() | flags::Break | flags::Reserved);
 }
 
-void cpu::PLP()
+template <auto Accuracy> void cpu::PLP()
 {
-  tick();
-  tick();
-  state.set_ps(pop());
+  tick<Accuracy>();
+  tick<Accuracy>();
+  state.set_ps(pop<Accuracy>());
+  recheck_interrupts();
 }
 
 //
 // System
 //
 
-void cpu::INT_NMI()
+template <auto Accuracy> void cpu::INT_NMI()
 {
-  tick();
-  tick();
+  idle.active = false;
 
-  push(state.pc >> 8);
-  push(state.pc & 0xFF);
-  push(state.ps);
+  if constexpr (Accuracy == accuracy::Instruction) {
+    tick(base_cycles[0x00]);  // Same sequence as BRK
+  }
+
+  tick<Accuracy>();
+  tick<Accuracy>();
+
+  push<Accuracy>(state.pc >> 8);
+  push<Accuracy>(state.pc & 0xFF);
+  push<Accuracy>(state.ps());
 
   state.set_flags(flags::Interrupt);
 
   constexpr uint16_t jmp_addr = 0xFFFA;
 
-  state.pc       = (memory_read(jmp_addr + 1) << 8) | memory_read(jmp_addr);
+  state.pc = (memory_read<Accuracy>(jmp_addr + 1) << 8) |
+             memory_read<Accuracy>(jmp_addr);
   state.nmi_flag = false;
 }
 
-void cpu::INT_RST()
+template <auto Accuracy> void cpu::INT_RST()
 {
-  tick();
-  tick();
+  idle.active = false;
+
+  tick<Accuracy>();
+  tick<Accuracy>();
 
   state.sp -= 3;
-  tick();
-  tick();
-  tick();
+  tick<Accuracy>();
+  tick<Accuracy>();
+  tick<Accuracy>();
 
   state.set_flags(flags::Interrupt);
 
   constexpr uint16_t jmp_addr = 0xFFFC;
-  state.pc = (memory_read(jmp_addr + 1) << 8) | memory_read(jmp_addr);
+  state.pc = (memory_read<Accuracy>(jmp_addr + 1) << 8) |
+             memory_read<Accuracy>(jmp_addr);
 }
 
-void cpu::INT_IRQ()
+template <auto Accuracy> void cpu::INT_IRQ()
 {
-  tick();
-  tick();
+  idle.active = false;
+
+  if constexpr (Accuracy == accuracy::Instruction) {
+    tick(base_cycles[0x00]);  // Same sequence as BRK
+  }
 
-  push(state.pc >> 8);
-  push(state.pc & 0xFF);
-  push(state.ps);
+  tick<Accuracy>();
+  tick<Accuracy>();
+
+  push<Accuracy>(state.pc >> 8);
+  push<Accuracy>(state.pc & 0xFF);
+  push<Accuracy>(state.ps());
 
   state.set_flags(flags::Interrupt);
 
   constexpr uint16_t jmp_addr = 0xFFFE;
-  state.pc = (memory_read(jmp_addr + 1) << 8) | memory_read(jmp_addr);
+  state.pc = (memory_read<Accuracy>(jmp_addr + 1) << 8) |
+             memory_read<Accuracy>(jmp_addr);
 }
 
-void cpu::INT_BRK()
+template <auto Accuracy> void cpu::INT_BRK()
 {
-  tick();
+  tick<Accuracy>();
 
-  push(state.pc >> 8);
-  push(state.pc & 0xFF);
-  push(state.ps | flags::Break | flags::Reserved);
+  push<Accuracy>(state.pc >> 8);
+  push<Accuracy>(state.pc & 0xFF);
+  push<Accuracy>(state.ps() | flags::Break | flags::Reserved);
 
   state.set_flags(flags::Interrupt);
 
   constexpr uint16_t jmp_addr = 0xFFFE;
-  state.pc = (memory_read(jmp_addr + 1) << 8) | memory_read(jmp_addr);
+  state.pc = (memory_read<Accuracy>(jmp_addr + 1) << 8) |
+             memory_read<Accuracy>(jmp_addr);
 }
 
-void cpu::NOP()
+template <auto Accuracy> void cpu::NOP()
 {
-  tick();
+  tick<Accuracy>();
 }
 
 //
 // Unofficial instructions
 //
 
-template <auto Mode> void cpu::NOP()
+template <auto Accuracy, auto Mode> void cpu::NOP()
 {
-  get_operand<Mode>();  // Discard it
-  tick();
+  get_operand<Accuracy, Mode>();  // Discard it
+  tick<Accuracy>();
 }
 
-template <auto Mode> void cpu::LAX()
+template <auto Accuracy, auto Mode> void cpu::LAX()
 {
-  const auto addr  = get_operand<Mode>();
-  const auto value = memory_read(addr);
+  const auto value = read_operand<Accuracy, Mode>();
 
   state.set_x(value);
   state.set_a(value);
 }
 
-template <auto Mode> void cpu::SAX()
+template <auto Accuracy, auto Mode> void cpu::SAX()
 {
-  const auto addr = get_operand<Mode>();
+  const auto addr = get_operand<Accuracy, Mode>();
 
-  memory_write(addr, state.a & state.x);
+  memory_write<Accuracy>(addr, state.a & state.x);
 }
 
-template <auto Mode> void cpu::DCP()
+template <auto Accuracy, auto Mode> void cpu::DCP()
 {
-  const auto    addr  = get_operand<Mode>();
-  const uint8_t value = memory_read(addr) - 1;
+  const auto    addr  = get_operand<Accuracy, Mode>();
+  const uint8_t value = memory_read<Accuracy>(addr) - 1;
 
-  tick();
+  tick<Accuracy>();
 
   state.clear_flags(flags::Carry);
 
@@ -989,180 +1521,304 @@ template <auto Mode> void cpu::DCP()
 
   state.update_nz(state.a - value);
 
-  memory_write(addr, value);
+  memory_write<Accuracy>(addr, value);
 }
 
-template <auto Mode> void cpu::ISB()
+template <auto Accuracy, auto Mode> void cpu::ISB()
 {
-  const auto    addr  = get_operand<Mode>();
-  const uint8_t value = memory_read(addr) + 1;
+  const auto    addr  = get_operand<Accuracy, Mode>();
+  const uint8_t value = memory_read<Accuracy>(addr) + 1;
 
-  tick();
+  tick<Accuracy>();
 
   add(value ^ 0xFF);
-  memory_write(addr, value);
+  memory_write<Accuracy>(addr, value);
 }
 
-template <auto Mode> void cpu::SLO()
+template <auto Accuracy, auto Mode> void cpu::SLO()
 {
-  const auto addr  = get_operand<Mode>();
-  const auto value = memory_read(addr);
+  const auto addr  = get_operand<Accuracy, Mode>();
+  const auto value = memory_read<Accuracy>(addr);
 
-  tick();
+  tick<Accuracy>();
 
   const auto shifted = shift_left(value);
 
   state.set_a(state.a | shifted);
-  memory_write(addr, shifted);
+  memory_write<Accuracy>(addr, shifted);
 }
 
-template <auto Mode> void cpu::RLA()
+template <auto Accuracy, auto Mode> void cpu::RLA()
 {
-  const auto addr  = get_operand<Mode>();
-  const auto value = memory_read(addr);
+  const auto addr  = get_operand<Accuracy, Mode>();
+  const auto value = memory_read<Accuracy>(addr);
 
-  tick();
+  tick<Accuracy>();
 
   const auto shifted = rotate_left(value);
 
   state.set_a(state.a & shifted);
-  memory_write(addr, shifted);
+  memory_write<Accuracy>(addr, shifted);
 }
 
-template <auto Mode> void cpu::SRE()
+template <auto Accuracy, auto Mode> void cpu::SRE()
 {
-  const auto addr  = get_operand<Mode>();
-  const auto value = memory_read(addr);
+  const auto addr  = get_operand<Accuracy, Mode>();
+  const auto value = memory_read<Accuracy>(addr);
 
-  tick();
+  tick<Accuracy>();
 
   const auto shifted = shift_right(value);
 
   state.set_a(state.a ^ shifted);
-  memory_write(addr, shifted);
+  memory_write<Accuracy>(addr, shifted);
 }
 
-template <auto Mode> void cpu::RRA()
+template <auto Accuracy, auto Mode> void cpu::RRA()
 {
-  const auto addr  = get_operand<Mode>();
-  const auto value = memory_read(addr);
+  const auto addr  = get_operand<Accuracy, Mode>();
+  const auto value = memory_read<Accuracy>(addr);
 
-  tick();
+  tick<Accuracy>();
 
   const auto result = rotate_right(value);
 
   add(result);
-  memory_write(addr, result);
+  memory_write<Accuracy>(addr, result);
 }
 
-template <auto Mode> uint16_t cpu::get_operand()
+template <auto Accuracy, auto Mode> void cpu::ANC()
 {
-  if constexpr (Mode != Immediate && Mode != Relative) {
-    throw;
-  }
-  const auto addr = state.pc;
+  const auto value = read_operand<Accuracy, Mode>();
 
-  ++state.pc;
+  state.set_a(state.a & value);
+  state.clear_flags(flags::Carry);
 
-  return addr;
+  if (state.a & 0x80) {
+    state.set_flags(flags::Carry);
+  }
 }
 
-template <> uint16_t cpu::get_operand<ZeroPage>()
+template <auto Accuracy, auto Mode> void cpu::ALR()
 {
-  return memory_read(get_operand<Immediate>());
+  const auto value = read_operand<Accuracy, Mode>();
+
+  state.set_a(shift_right(state.a & value));
 }
 
-template <> uint16_t cpu::get_operand<ZeroPageX>()
+template <auto Accuracy, auto Mode> void cpu::ARR()
 {
-  tick();
+  const auto value = read_operand<Accuracy, Mode>();
 
-  return (get_operand<ZeroPage>() + state.x) & 0xFF;
-}
+  const uint8_t result =
+      ((state.a & value) >> 1) | (state.check_flags(flags::Carry) << 7);
 
-template <> uint16_t cpu::get_operand<ZeroPageY>()
-{
-  tick();
+  state.set_a(result);
+  state.clear_flags(flags::Carry | flags::Overflow);
+
+  if (result & 0x40) {
+    state.set_flags(flags::Carry);
+  }
 
-  return (get_operand<ZeroPage>() + state.y) & 0xFF;
+  if (((result >> 6) ^ (result >> 5)) & 1) {
+    state.set_flags(flags::Overflow);
+  }
 }
 
-template <> uint16_t cpu::get_operand<Absolute>()
+template <auto Accuracy, auto Mode> void cpu::AXS()
 {
-  const auto base_addr = get_operand<Immediate>();
+  const auto    value = read_operand<Accuracy, Mode>();
+  const uint8_t base  = state.a & state.x;
 
-  ++state.pc;
+  state.clear_flags(flags::Carry);
 
-  return (memory_read(base_addr + 1) << 8) | memory_read(base_addr);
+  if (base >= value) {
+    state.set_flags(flags::Carry);
+  }
+
+  state.set_x(base - value);
 }
 
-template <> uint16_t cpu::get_operand<AbsoluteX>()
+template <auto Accuracy, auto Mode> void cpu::LAS()
 {
-  const auto base_addr = get_operand<Absolute>();
+  const auto    addr   = get_operand<Accuracy, Mode>();
+  const uint8_t result = memory_read<Accuracy>(addr) & state.sp;
 
-  if (crosses_page(base_addr, state.x)) {
-    tick();
-  }
+  state.sp = result;
+  state.set_x(result);
+  state.set_a(result);
+}
+
+template <auto Accuracy, auto Mode> void cpu::XAA()
+{
+  const auto value = read_operand<Accuracy, Mode>();
 
-  return base_addr + state.x;
+  state.set_a(state.x & value);
 }
 
-template <> uint16_t cpu::get_operand<AbsoluteX_Exception>()
+//
+// The unstable stores AND the value with the high byte of the base address
+// plus one. The base address is recovered by undoing the index
+//
+
+template <auto Accuracy, auto Mode> void cpu::AHX()
 {
-  const auto base_addr = get_operand<Absolute>();
+  const auto     addr = get_operand<Accuracy, Mode>();
+  const uint16_t base = addr - state.y;
 
-  return base_addr + state.x;
+  tick<Accuracy>();
+  memory_write<Accuracy>(addr, state.a & state.x & ((base >> 8) + 1));
 }
 
-template <> uint16_t cpu::get_operand<AbsoluteY>()
+template <auto Accuracy, auto Mode> void cpu::TAS()
 {
-  const auto base_addr = get_operand<Absolute>();
+  const auto     addr = get_operand<Accuracy, Mode>();
+  const uint16_t base = addr - state.y;
 
-  if (crosses_page(base_addr, state.y)) {
-    tick();
-  }
+  state.sp = state.a & state.x;
 
-  return base_addr + state.y;
+  tick<Accuracy>();
+  memory_write<Accuracy>(addr, state.sp & ((base >> 8) + 1));
 }
 
-template <> uint16_t cpu::get_operand<AbsoluteY_Exception>()
+template <auto Accuracy, auto Mode> void cpu::SHX()
 {
-  const auto base_addr = get_operand<Absolute>();
+  const auto     addr = get_operand<Accuracy, Mode>();
+  const uint16_t base = addr - state.y;
 
-  return base_addr + state.y;
+  tick<Accuracy>();
+  memory_write<Accuracy>(addr, state.x & ((base >> 8) + 1));
 }
 
-template <> uint16_t cpu::get_operand<Indirect>()
+template <auto Accuracy, auto Mode> void cpu::SHY()
 {
-  const auto base_addr = get_operand<Absolute>();
-  return memory_read(base_addr) |
-         (memory_read((base_addr & 0xFF00) | ((base_addr + 1) & 0xFF)) << 8);
+  const auto     addr = get_operand<Accuracy, Mode>();
+  const uint16_t base = addr - state.x;
+
+  tick<Accuracy>();
+  memory_write<Accuracy>(addr, state.y & ((base >> 8) + 1));
 }
 
-template <> uint16_t cpu::get_operand<IndirectX>()
+template <auto Accuracy> void cpu::JAM()
 {
-  const auto base_addr = get_operand<ZeroPageX>();
-  return (memory_read((base_addr + 1) & 0xFF) << 8) | memory_read(base_addr);
+  // Keep fetching the same opcode, only a reset gets the CPU out of here
+  --state.pc;
+  tick<Accuracy>();
 }
 
-template <> uint16_t cpu::get_operand<IndirectY>()
+// The next byte of the instruction. Running from a block, it was read when
+// the block was decoded and only its cycle is left to charge
+template <auto Accuracy> uint8_t cpu::fetch()
 {
-  const auto     zp_addr = get_operand<ZeroPage>();
-  const uint16_t base_addr =
-      ((memory_read((zp_addr + 1) & 0xFF) << 8) | memory_read(zp_addr));
+  const uint16_t addr = state.pc++;
 
-  if (crosses_page(base_addr, state.y)) {
-    tick();
+  if (operands) {
+    tick<Accuracy>();
+    return *operands++;
   }
 
-  return base_addr + state.y;
+  return memory_read<Accuracy>(addr);
+}
+
+// The byte an instruction works on: the one after the opcode, or the one at
+// the address the operand makes
+template <auto Accuracy, auto Mode> uint8_t cpu::read_operand()
+{
+  if constexpr (Mode == Immediate) {
+    return fetch<Accuracy>();
+  } else {
+    return memory_read<Accuracy>(get_operand<Accuracy, Mode>());
+  }
 }
 
-template <> uint16_t cpu::get_operand<IndirectY_Exception>()
+// Page crossing costs its extra cycle with either accuracy, the cycle table
+// only has the base count
+template <auto Accuracy, auto Mode> uint16_t cpu::get_operand()
 {
-  const auto     zp_addr = get_operand<ZeroPage>();
-  const uint16_t base_addr =
-      ((memory_read((zp_addr + 1) & 0xFF) << 8) | memory_read(zp_addr));
+  if constexpr (Mode == Immediate || Mode == Relative) {
+    const auto addr = state.pc;
 
-  return base_addr + state.y;
+    ++state.pc;
+
+    return addr;
+  } else if constexpr (Mode == ZeroPage) {
+    return fetch<Accuracy>();
+  } else if constexpr (Mode == ZeroPageX) {
+    tick<Accuracy>();
+
+    return (get_operand<Accuracy, ZeroPage>() + state.x) & 0xFF;
+  } else if constexpr (Mode == ZeroPageY) {
+    tick<Accuracy>();
+
+    return (get_operand<Accuracy, ZeroPage>() + state.y) & 0xFF;
+  } else if constexpr (Mode == Absolute) {
+    const uint8_t low  = fetch<Accuracy>();
+    const uint8_t high = fetch<Accuracy>();
+
+    return (high << 8) | low;
+  } else if constexpr (Mode == AbsoluteX || Mode == AbsoluteX_Exception) {
+    const auto base_addr = get_operand<Accuracy, Absolute>();
+
+    if (Mode == AbsoluteX && crosses_page(base_addr, state.x)) {
+      tick(1);
+    }
+
+    return base_addr + state.x;
+  } else if constexpr (Mode == AbsoluteY || Mode == AbsoluteY_Exception) {
+    const auto base_addr = get_operand<Accuracy, Absolute>();
+
+    if (Mode == AbsoluteY && crosses_page(base_addr, state.y)) {
+      tick(1);
+    }
+
+    return base_addr + state.y;
+  } else if constexpr (Mode == Indirect) {
+    const auto base_addr = get_operand<Accuracy, Absolute>();
+    return memory_read<Accuracy>(base_addr) |
+           (memory_read<Accuracy>(
+                (base_addr & 0xFF00) | ((base_addr + 1) & 0xFF))
+            << 8);
+  } else if constexpr (Mode == IndirectX) {
+    const auto base_addr = get_operand<Accuracy, ZeroPageX>();
+    return (memory_read<Accuracy>((base_addr + 1) & 0xFF) << 8) |
+           memory_read<Accuracy>(base_addr);
+  } else if constexpr (Mode == IndirectY || Mode == IndirectY_Exception) {
+    const auto     zp_addr   = get_operand<Accuracy, ZeroPage>();
+    const uint16_t base_addr =
+        (memory_read<Accuracy>((zp_addr + 1) & 0xFF) << 8) |
+        memory_read<Accuracy>(zp_addr);
+
+    if (Mode == IndirectY && crosses_page(base_addr, state.y)) {
+      tick(1);
+    }
+
+    return base_addr + state.y;
+  } else {
+    static_assert(Mode == Immediate, "No operand for this addressing mode");
+  }
 }
-}  // namespace nes
\ No newline at end of file
+
+//
+// Used from cpu.cpp
+//
+
+template void cpu::run<accuracy::Cycle>();
+template void cpu::run<accuracy::Instruction>();
+template void cpu::run_cached<accuracy::Cycle>();
+template void cpu::run_cached<accuracy::Instruction>();
+#ifdef NES_PROFILER
+template void cpu::run_profiled<accuracy::Cycle>();
+template void cpu::run_profiled<accuracy::Instruction>();
+#endif
+template void cpu::execute<accuracy::Cycle>();
+template void cpu::INT_NMI<accuracy::Cycle>();
+template void cpu::INT_NMI<accuracy::Instruction>();
+template void cpu::INT_IRQ<accuracy::Cycle>();
+template void cpu::INT_IRQ<accuracy::Instruction>();
+template void cpu::INT_RST<accuracy::Cycle>();
+
+template uint8_t cpu::memory_read<accuracy::Cycle>(const uint16_t);
+template void    cpu::memory_write<accuracy::Cycle>(
+    const uint16_t,
+    const uint8_t);
+}  // namespace nes
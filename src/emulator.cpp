@@ -1,9 +1,14 @@
 #include "emulator.h"
 
+#include <vector>
+
+#include "apu.h"
+#include "log.h"
+
 namespace nes {
 emulator::emulator()
 {
-  SDL_Init(SDL_INIT_VIDEO);
+  SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO);
   // Bilinear filter
   // SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "linear");
 
@@ -41,6 +46,8 @@ void emulator::close()
   // valgrind --log-file='valgrind%p.log' --track-origins=yes --leak-check=full
   // ./nes-emulator
 
+  this->set_audio(nullptr);
+
   texture  = nullptr;
   renderer = nullptr;
   window   = nullptr;
@@ -52,6 +59,50 @@ void emulator::set_bus(nes::bus& ref)
   this->bus = &ref;
 }
 
+// Plays what the APU puts in the ring, nullptr stops it. The ring has to
+// outlive the playing, and this runs on the thread that pushes to it
+void emulator::set_audio(nes::audio_ring* ring)
+{
+  if (audio_device) {
+    SDL_CloseAudioDevice(audio_device);
+    audio_device = 0;
+  }
+
+  if (!ring) {
+    return;
+  }
+
+  SDL_AudioSpec wanted{};
+  wanted.freq     = nes::apu::sample_rate;
+  wanted.format   = AUDIO_S16SYS;
+  wanted.channels = 1;
+  wanted.samples  = 512;
+  wanted.callback = &emulator::play;
+  wanted.userdata = ring;
+
+  // A cushion of silence, so frames land a little ahead of the callback
+  const std::vector<int16_t> silence(ring->capacity() / 4);
+  ring->push(silence.data(), silence.size());
+
+  SDL_AudioSpec obtained{};
+  audio_device = SDL_OpenAudioDevice(nullptr, 0, &wanted, &obtained, 0);
+
+  if (!audio_device) {
+    LOG(log::Error) << "Couldn't open the audio device: " << SDL_GetError();
+    return;
+  }
+
+  SDL_PauseAudioDevice(audio_device, 0);
+}
+
+// SDL's audio thread asking for more. The ring never blocks it
+void emulator::play(void* ring, Uint8* stream, int length)
+{
+  static_cast<nes::audio_ring*>(ring)->pop(
+      reinterpret_cast<int16_t*>(stream),
+      static_cast<size_t>(length) / sizeof(int16_t));
+}
+
 uint8_t emulator::get_controller(const size_t n) const
 {
   uint8_t state = 0;
@@ -68,16 +119,84 @@ uint8_t emulator::get_controller(const size_t n) const
   return state;
 }
 
-void emulator::update_frame(const uint32_t* frame)
+void emulator::update_frame(const nes::frame& frame)
+{
+  if (pending) {
+    texture_current = false;
+  }
+
+  pending = &frame;
+}
+
+// Each run of changed lines is converted straight into the texture with
+// one lock. Returns whether anything was uploaded
+bool emulator::upload(const nes::frame& frame)
 {
-  SDL_UpdateTexture(texture.get(), nullptr, frame, width * sizeof(uint32_t));
+  auto dirty = frame.dirty;
+
+  if (!texture_current) {
+    dirty.set();
+  }
+
+  texture_current = true;
+
+  for (int y = 0; y < nes::frame::height;) {
+    if (!dirty[y]) {
+      ++y;
+      continue;
+    }
+
+    int end = y + 1;
+
+    while (end < nes::frame::height && dirty[end]) {
+      ++end;
+    }
+
+    const SDL_Rect rect   = {0, y, nes::frame::width, end - y};
+    void*          pixels = nullptr;
+    int            pitch  = 0;
+
+    if (SDL_LockTexture(texture.get(), &rect, &pixels, &pitch) == 0) {
+      frame.to_rgba(static_cast<uint32_t*>(pixels),
+                    static_cast<size_t>(pitch) / sizeof(uint32_t), y,
+                    end - y);
+      SDL_UnlockTexture(texture.get());
+    } else {
+      texture_current = false;
+    }
+
+    y = end;
+  }
+
+  return dirty.any();
 }
 
 void emulator::draw()
 {
+  if (pending) {
+    redraw  = this->upload(*pending) || redraw;
+    pending = nullptr;
+  }
+
+  // A frame like the one on screen isn't copied nor presented, so there's
+  // no vsync to wait on either
+  if (!redraw) {
+    const float left = frame_time - frame_timer.elapsed_time();
+
+    if (left > 0) {
+      SDL_Delay(static_cast<Uint32>(left * 1000));
+    }
+
+    frame_timer.restart();
+    return;
+  }
+
   SDL_RenderClear(renderer.get());
   SDL_RenderCopy(renderer.get(), texture.get(), nullptr, nullptr);
   SDL_RenderPresent(renderer.get());
+
+  redraw = false;
+  frame_timer.restart();
 }
 
 void emulator::run()
@@ -88,6 +207,13 @@ void emulator::run()
     while (SDL_PollEvent(&e)) {
       switch (e.type) {
         case SDL_QUIT: return;
+        case SDL_KEYDOWN:
+          if (e.key.keysym.scancode == KEY_DUMP_TRACE) {
+            this->bus->dump_trace("nes-emulator.trace");
+          }
+          break;
+        // Shown again, resized and so on
+        case SDL_WINDOWEVENT: redraw = true; break;
       }
     }
 
@@ -0,0 +1,82 @@
+#include "frame.h"
+
+#include "compositor.h"
+
+namespace nes {
+namespace {
+// SDL_PIXELFORMAT_RGBA32, R in the low byte
+constexpr uint32_t rgb(const uint32_t r, const uint32_t g, const uint32_t b)
+{
+  return 0xFF000000 | (b << 16) | (g << 8) | r;
+}
+
+// clang-format off
+constexpr std::array<uint32_t, 0x40> base_colors = {
+    rgb( 84,  84,  84), rgb(  0,  30, 116), rgb(  8,  16, 144), rgb( 48,   0, 136),
+    rgb( 68,   0, 100), rgb( 92,   0,  48), rgb( 84,   4,   0), rgb( 60,  24,   0),
+    rgb( 32,  42,   0), rgb(  8,  58,   0), rgb(  0,  64,   0), rgb(  0,  60,   0),
+    rgb(  0,  50,  60), rgb(  0,   0,   0), rgb(  0,   0,   0), rgb(  0,   0,   0),
+    rgb(152, 150, 152), rgb(  8,  76, 196), rgb( 48,  50, 236), rgb( 92,  30, 228),
+    rgb(136,  20, 176), rgb(160,  20, 100), rgb(152,  34,  32), rgb(120,  60,   0),
+    rgb( 84,  90,   0), rgb( 40, 114,   0), rgb(  8, 124,   0), rgb(  0, 118,  40),
+    rgb(  0, 102, 120), rgb(  0,   0,   0), rgb(  0,   0,   0), rgb(  0,   0,   0),
+    rgb(236, 238, 236), rgb( 76, 154, 236), rgb(120, 124, 236), rgb(176,  98, 236),
+    rgb(228,  84, 236), rgb(236,  88, 180), rgb(236, 106, 100), rgb(212, 136,  32),
+    rgb(160, 170,   0), rgb(116, 196,   0), rgb( 76, 208,  32), rgb( 56, 204, 108),
+    rgb( 56, 180, 204), rgb( 60,  60,  60), rgb(  0,   0,   0), rgb(  0,   0,   0),
+    rgb(236, 238, 236), rgb(168, 204, 236), rgb(188, 188, 236), rgb(212, 178, 236),
+    rgb(236, 174, 236), rgb(236, 174, 212), rgb(236, 180, 176), rgb(228, 196, 144),
+    rgb(204, 210, 120), rgb(180, 222, 120), rgb(168, 226, 144), rgb(152, 226, 180),
+    rgb(160, 214, 228), rgb(160, 162, 160), rgb(  0,   0,   0), rgb(  0,   0,   0),
+};
+// clang-format on
+
+// Each emphasis bit darkens the two channels it doesn't name, to about 82%
+constexpr uint32_t emphasize(const uint32_t color, const size_t emphasis)
+{
+  uint32_t result = 0xFF000000;
+
+  for (size_t channel = 0; channel < 3; ++channel) {
+    uint32_t value = (color >> (channel * 8)) & 0xFF;
+
+    for (size_t bit = 0; bit < 3; ++bit) {
+      if ((emphasis & (1 << bit)) && bit != channel) {
+        value = value * 209 / 256;
+      }
+    }
+
+    result |= value << (channel * 8);
+  }
+
+  return result;
+}
+
+// 64 colours for each of the 8 emphasis settings
+constexpr std::array<uint32_t, 0x200> build_palette()
+{
+  std::array<uint32_t, 0x200> table{};
+
+  for (size_t i = 0; i < table.size(); ++i) {
+    table[i] = emphasize(base_colors[i & 0x3F], i >> 6);
+  }
+
+  return table;
+}
+
+constexpr auto rgba_palette = build_palette();
+}  // namespace
+
+void frame::to_rgba(
+    uint32_t*    out,
+    const size_t pitch,
+    const int    first,
+    const int    count) const
+{
+  const auto convert = compositor::best().convert;
+
+  for (int y = first; y < first + count; ++y) {
+    convert(&pixels[y * width], &rgba_palette[(emphasis[y] & 7) << 6], out);
+    out += pitch;
+  }
+}
+}  // namespace nes
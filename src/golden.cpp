@@ -0,0 +1,350 @@
+#include "golden.h"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <fstream>
+#include <sstream>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <fmt/format.h>
+
+namespace nes {
+
+//
+// Field parsing. Both logs put the registers after the disassembly as
+// "A:00 X:00 Y:00", they differ in the stack pointer (SP: or S:), in the
+// flags (hex or nvUbdIzc) and in how the cycle is written
+//
+
+namespace {
+template <typename T>
+bool number(std::string_view text, const size_t pos, const int base, T& out)
+{
+  if (pos == std::string_view::npos) {
+    return false;
+  }
+
+  const char* first = text.data() + pos;
+  const char* last  = text.data() + text.size();
+
+  while (first != last && *first == ' ') {
+    ++first;
+  }
+
+  return std::from_chars(first, last, out, base).ec == std::errc{};
+}
+
+// Where the value of " name" starts, npos if the line doesn't have it
+size_t field(std::string_view text, std::string_view name)
+{
+  const auto pos = text.find(name);
+  return pos == std::string_view::npos ? pos : pos + name.size();
+}
+
+bool flags_from_letters(std::string_view text, const size_t pos, uint8_t& out)
+{
+  if (pos == std::string_view::npos || text.size() < pos + 8) {
+    return false;
+  }
+
+  out = 0;
+
+  for (size_t bit = 0; bit < 8; ++bit) {
+    const char letter = text[pos + bit];
+
+    if (letter >= 'A' && letter <= 'Z') {
+      out |= 0x80 >> bit;
+    }
+  }
+
+  return true;
+}
+}  // namespace
+
+golden_trace::golden_trace(const std::filesystem::path& path)
+{
+#ifndef _WIN32
+  const int file = ::open(path.c_str(), O_RDONLY);
+
+  if (file < 0) {
+    throw std::runtime_error("Can't open the reference trace");
+  }
+
+  struct stat info {};
+  void*       view = MAP_FAILED;
+
+  // An empty file maps to nothing, it's just a reference that's over
+  if (::fstat(file, &info) == 0 && info.st_size > 0) {
+    size = static_cast<size_t>(info.st_size);
+    view = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+
+    if (view == MAP_FAILED) {
+      ::close(file);
+      throw std::runtime_error("Can't map the reference trace");
+    }
+
+    ::madvise(view, size, MADV_SEQUENTIAL);
+    data = static_cast<const char*>(view);
+  }
+
+  ::close(file);
+#else
+  std::ifstream file(path, std::ios::binary);
+
+  if (!file) {
+    throw std::runtime_error("Can't open the reference trace");
+  }
+
+  std::ostringstream contents;
+  contents << file.rdbuf();
+  fallback = contents.str();
+  data     = fallback.data();
+  size     = fallback.size();
+#endif
+
+  cursor = data;
+}
+
+golden_trace::~golden_trace()
+{
+#ifndef _WIN32
+  if (data) {
+    ::munmap(const_cast<char*>(data), size);
+  }
+#endif
+}
+
+uint64_t golden_trace::matched() const
+{
+  return next;
+}
+
+// Skips blank lines and whatever doesn't start with an address, such as
+// the header Mesen writes
+bool golden_trace::next_line(std::string_view& out)
+{
+  const char* end = data + size;
+
+  while (cursor && cursor < end) {
+    const auto* newline = static_cast<const char*>(
+        std::memchr(cursor, '\n', static_cast<size_t>(end - cursor)));
+    const char* stop = newline ? newline : end;
+
+    out    = std::string_view(cursor, static_cast<size_t>(stop - cursor));
+    cursor = newline ? newline + 1 : end;
+
+    if (!out.empty() && out.back() == '\r') {
+      out.remove_suffix(1);
+    }
+
+    const auto digit = [&out](const size_t i) {
+      return std::isxdigit(static_cast<unsigned char>(out[i])) != 0;
+    };
+
+    if (out.size() >= 4 && digit(0) && digit(1) && digit(2) && digit(3)) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool golden_trace::parse(std::string_view text, reference_line& out)
+{
+  if (!number(text.substr(0, 4), 0, 16, out.pc)) {
+    return false;
+  }
+
+  // The opcode follows the address, with a '$' in front in Mesen's logs
+  size_t opcode = text.find_first_not_of(" $", 4);
+
+  if (!number(text.substr(0, opcode + 2), opcode, 16, out.opcode) ||
+      !number(text, field(text, " A:"), 16, out.a) ||
+      !number(text, field(text, " X:"), 16, out.x) ||
+      !number(text, field(text, " Y:"), 16, out.y)) {
+    return false;
+  }
+
+  const auto sp = field(text, " SP:");
+
+  if (!number(text, sp != std::string_view::npos ? sp : field(text, " S:"),
+              16, out.sp)) {
+    return false;
+  }
+
+  const auto p = field(text, " P:");
+
+  if (p < text.size() &&
+      (text[p] == 'n' || text[p] == 'N' || text[p] == '-')) {
+    if (!flags_from_letters(text, p, out.p)) {
+      return false;
+    }
+  } else if (!number(text.substr(0, p + 2), p, 16, out.p)) {
+    return false;
+  }
+
+  // nestest.log has "PPU: 0, 21 CYC:7" with CPU cycles, older copies and
+  // nes-trace-decode have "CYC:  0" with the dot. Mesen writes Cyc or Cycle
+  auto cycle = field(text, " CYC:");
+
+  out.ppu_dot = cycle != std::string_view::npos &&
+                text.find(" PPU:") == std::string_view::npos;
+
+  if (cycle == std::string_view::npos) {
+    cycle = field(text, " Cyc:");
+  }
+
+  if (cycle == std::string_view::npos) {
+    cycle = field(text, " Cycle:");
+  }
+
+  out.has_cycle = number(text, cycle, 10, out.cycle);
+  return true;
+}
+
+bool golden_trace::matches(
+    const reference_line& line,
+    const trace_record&   record)
+{
+  if (record.pc != line.pc || record.opcode != line.opcode ||
+      record.a != line.a || record.x != line.x || record.y != line.y ||
+      (record.p & 0xCF) != (line.p & 0xCF) || record.sp != line.sp) {
+    return false;
+  }
+
+  if (!line.has_cycle) {
+    return true;
+  }
+
+  if (line.ppu_dot) {
+    return static_cast<uint64_t>(nestest_dot(record)) == line.cycle;
+  }
+
+  return record.cycle == line.cycle;
+}
+
+std::string golden_trace::differences(
+    const reference_line& line,
+    const trace_record&   record)
+{
+  std::string result;
+
+  const auto check = [&result](const char* name, const auto ours,
+                               const auto theirs, const bool hex) {
+    if (ours == theirs) {
+      return;
+    }
+
+    if (hex) {
+      result += fmt::format("  {} is {:02X}, expected {:02X}\n", name, ours,
+                            theirs);
+    } else {
+      result += fmt::format("  {} is {}, expected {}\n", name, ours, theirs);
+    }
+  };
+
+  check("PC", record.pc, line.pc, true);
+  check("opcode", record.opcode, line.opcode, true);
+  check("A", record.a, line.a, true);
+  check("X", record.x, line.x, true);
+  check("Y", record.y, line.y, true);
+  check("P", record.p & 0xCF, line.p & 0xCF, true);
+  check("SP", record.sp, line.sp, true);
+
+  if (line.has_cycle && line.ppu_dot) {
+    check("PPU dot", static_cast<uint64_t>(nestest_dot(record)), line.cycle,
+          false);
+  } else if (line.has_cycle) {
+    check("cycle", record.cycle, line.cycle, false);
+  }
+
+  return result;
+}
+
+golden_state::golden_state golden_trace::follow(const trace_ring& ring)
+{
+  const uint64_t end = ring.written();
+
+  if (state != golden_state::Matching) {
+    return state;
+  }
+
+  if (end - next > ring.capacity()) {
+    throw std::runtime_error(
+        "The trace ring went round before it was compared, make it larger");
+  }
+
+  for (; next < end; ++next) {
+    std::string_view text;
+
+    if (!this->next_line(text)) {
+      state = golden_state::Finished;
+      break;
+    }
+
+    actual = ring.at(next);
+
+    if (!parse(text, expected)) {
+      throw std::runtime_error(
+          fmt::format("Can't read line {} of the reference trace", next + 1));
+    }
+
+    if (!matches(expected, actual)) {
+      failed_line = text;
+      state       = golden_state::Diverged;
+      break;
+    }
+
+    previous[next % context] = text;
+  }
+
+  return state;
+}
+
+void golden_trace::report(std::ostream& out, const trace_ring& ring) const
+{
+  if (state == golden_state::Matching) {
+    out << fmt::format("{} instructions match so far\n", next);
+    return;
+  }
+
+  if (state == golden_state::Finished) {
+    out << fmt::format(
+        "The reference ends after {} instructions, all of them match\n", next);
+    return;
+  }
+
+  const uint64_t first  = next > context ? next - context : 0;
+  const uint64_t oldest = ring.written() > ring.capacity()
+                              ? ring.written() - ring.capacity()
+                              : 0;
+
+  out << fmt::format("Diverged from the reference at line {}\n", next + 1);
+  out << "\nReference:\n";
+
+  for (uint64_t i = first; i < next; ++i) {
+    out << "  " << previous[i % context] << '\n';
+  }
+
+  out << "> " << failed_line << '\n';
+  out << "\nEmulator:\n";
+
+  for (uint64_t i = std::max(first, oldest); i <= next; ++i) {
+    out << (i == next ? "> " : "  ");
+    write_nestest(out, i == next ? actual : ring.at(i));
+  }
+
+  out << '\n' << differences(expected, actual);
+}
+
+}  // namespace nes
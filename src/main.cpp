@@ -1,6 +1,7 @@
 #include <fstream>
 
 #include "apu.h"
+#include "audio_ring.h"
 #include "bus.h"
 #include "cartridge.h"
 #include "controller.h"
@@ -9,6 +10,9 @@
 #include "emulator.h"
 #include "log.h"
 #include "ppu.h"
+#include "profiler.h"
+#include "render_thread.h"
+#include "trace.h"
 
 int main()
 {
@@ -23,7 +27,9 @@ int main()
   nes::apu        apu;
   nes::cartridge  cartridge;
   nes::controller controller;
+  nes::audio_ring audio;  // Outlives the emulator playing it
   nes::emulator   emulator;
+  nes::trace_ring trace;
   // nes::debugger   debugger{cpu};
 
   bus.set_component(cpu);
@@ -41,12 +47,51 @@ int main()
   controller.set_bus(bus);
   emulator.set_bus(bus);
 
+#ifdef NES_RENDER_THREAD
+  // Frames drawn on a thread of their own, a frame late
+  nes::render_thread render_thread;
+  ppu.set_render_thread(&render_thread);
+#endif
+
+  // The last instructions go to nes-emulator.trace on F12 or on a crash
+  trace.dump_on_crash("nes-emulator.trace");
+  cpu.set_trace(&trace);
+  // debugger.compare("../roms/nestest.log");
+
+#ifdef NES_PROFILER
+  nes::profiler profiler;
+  cpu.set_profiler(&profiler);
+#endif
+
+#ifdef NES_BLOCK_CACHE
+  cpu.use_block_cache();
+#endif
+
+#ifdef NES_IDLE_SKIP
+  cpu.skip_idle_loops();
+#endif
+
+#ifdef NES_INSTRUCTION_ACCURACY
+  cpu.set_accuracy(nes::accuracy::Instruction);
+#endif
+
   cartridge.load("../roms/ff.nes");
   cpu.power_on();
   ppu.power_on();
   apu.power_on();
 
+  // Each frame's samples go to SDL's audio thread through the ring
+  apu.set_output(&audio);
+  emulator.set_audio(&audio);
+
   emulator.run();
 
+  LOG(nes::log::Info) << "Audio samples missing: " << audio.underruns()
+                      << ", dropped: " << audio.overruns();
+
+#ifdef NES_PROFILER
+  profiler.dump("nes-emulator-profile");
+#endif
+
   return 0;
 }
\ No newline at end of file
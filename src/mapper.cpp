@@ -26,6 +26,13 @@ void mapper::set_mirroring(const int mode)
   this->bus->set_mirroring(mode);
 }
 
+// Lets the CPU reach PRG RAM without going through the mapper
+void mapper::map_prg_ram(const bool writable)
+{
+  this->bus->map_cpu_memory(
+      0x6000, 0x2000, prg_ram.data(), writable ? prg_ram.data() : nullptr);
+}
+
 uint8_t mapper::prg_read(const uint16_t addr) const
 {
   if (addr >= 0x8000) {
@@ -38,12 +45,14 @@ uint8_t mapper::prg_read(const uint16_t addr) const
   }
 }
 
-uint8_t mapper::chr_read(uint16_t addr) const
+// 8 KB PRG-ROM bank mapped at addr, -1 when addr isn't in PRG-ROM
+int mapper::prg_bank(const uint16_t addr) const
 {
-  const size_t slot     = addr / 0x400;
-  const size_t chr_addr = addr % 0x400;
+  if (addr < 0x8000) {
+    return -1;
+  }
 
-  return chr[chr_map[slot] + chr_addr];
+  return static_cast<int>(prg_map[(addr - 0x8000) / 0x2000] / 0x2000);
 }
 
 void mapper::prg_write(uint16_t, uint8_t)
@@ -52,11 +61,7 @@ void mapper::prg_write(uint16_t, uint8_t)
   throw std::runtime_error("Invalid write attempt. Writing isn't supported");
 }
 
-void mapper::chr_write(uint16_t, uint8_t)
-{
-  LOG(log::Error) << "Invalid write attempt. Writing isn't supported";
-  throw std::runtime_error("Invalid write attempt. Writing isn't supported");
-}
+void mapper::run_event() {}
 
 // size must be in KBs
 template <auto size> void mapper::set_prg_map(int slot, int page)
@@ -69,17 +74,36 @@ template <auto size> void mapper::set_prg_map(int slot, int page)
   }
 
   for (size_t i = 0; i < pages; ++i) {
-    prg_map[pages * slot + i] = ((pages_b * page) + 0x2000 * i) % prg.size();
+    const size_t index = pages * slot + i;
+
+    prg_map[index] = ((pages_b * page) + 0x2000 * i) % prg.size();
+
+    this->bus->map_cpu_memory(
+        0x8000 + 0x2000 * index, 0x2000, &prg[prg_map[index]], nullptr);
   }
 }
 
+// Lets the PPU read the banks without going through the mapper, and write
+// them too when they're CHR RAM. Only the 1 KB slots that end up pointing
+// somewhere else are reported as changed, so the PPU keeps what it decoded
+// from the rest
 template <auto size> void mapper::set_chr_map(int slot, int page)
 {
   constexpr size_t pages   = size;
   constexpr size_t pages_b = size * 0x400;  // In bytes
 
   for (size_t i = 0; i < size; ++i) {
-    chr_map[pages * slot + i] = ((pages_b * page) + 0x400 * i) % chr.size();
+    const size_t   index  = pages * slot + i;
+    const size_t   offset = ((pages_b * page) + 0x400 * i) % chr.size();
+    const uint16_t addr   = static_cast<uint16_t>(index * 0x400);
+
+    if (chr_map[index] != offset) {
+      this->bus->chr_map_changed(addr, 0x400);
+      chr_map[index] = offset;
+    }
+
+    this->bus->map_chr_memory(addr, 0x400, &chr[offset],
+                              info.chr_ram ? &chr[offset] : nullptr);
   }
 }
 
@@ -10,6 +10,7 @@ mapper0::mapper0(
 
 void mapper0::reset()
 {
+  map_prg_ram(false);
   set_prg_map<16>(0, 0);
   set_prg_map<16>(1, 1);
   set_chr_map<8>(0, 0);
@@ -18,6 +18,7 @@ void mapper1::reset()
   chr_bank_1 = 0;
   prg_bank   = 0;
 
+  map_prg_ram(true);
   this->apply();
 }
 
@@ -51,6 +52,8 @@ void mapper1::apply()
   }
 
   switch (control & 0b11) {
+    case 0: this->bus->set_mirroring(SingleLower); break;
+    case 1: this->bus->set_mirroring(SingleUpper); break;
     case 2: this->bus->set_mirroring(Vertical); break;
     case 3: this->bus->set_mirroring(Horizontal); break;
   }
@@ -87,9 +90,4 @@ void mapper1::prg_write(const uint16_t addr, const uint8_t value)
     }
   }
 }
-
-void mapper1::chr_write(const uint16_t addr, const uint8_t value)
-{
-  chr[addr] = value;
-}
 }  // namespace nes
\ No newline at end of file
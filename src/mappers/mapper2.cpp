@@ -10,6 +10,7 @@ mapper2::mapper2(
 
 void mapper2::reset()
 {
+  map_prg_ram(false);
   set_prg_map<16>(0, 0);
   set_prg_map<16>(1, -1);
   set_chr_map<8>(0, 0);
@@ -25,9 +26,4 @@ void mapper2::prg_write(const uint16_t addr, const uint8_t value)
     // Error
   }
 }
-
-void mapper2::chr_write(const uint16_t addr, const uint8_t value)
-{
-  chr[addr] = value;
-}
 }  // namespace nes
\ No newline at end of file
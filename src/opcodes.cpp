@@ -0,0 +1,105 @@
+#include "opcodes.h"
+
+#include <array>
+
+namespace nes {
+namespace opcodes {
+
+namespace {
+using namespace addressing_mode;
+
+// clang-format off
+constexpr std::array<std::string_view, 0x100> mnemonics = {
+    // 0     1      2       3       4       5      6      7       8      9       A       B       C       D      E      F
+    "BRK",  "ORA", "*JAM", "*SLO", "*NOP", "ORA", "ASL", "*SLO", "PHP", "ORA",  "ASL",  "*ANC", "*NOP", "ORA", "ASL", "*SLO",  // 0
+    "BPL",  "ORA", "*JAM", "*SLO", "*NOP", "ORA", "ASL", "*SLO", "CLC", "ORA",  "*NOP", "*SLO", "*NOP", "ORA", "ASL", "*SLO",  // 1
+    "JSR",  "AND", "*JAM", "*RLA", "BIT",  "AND", "ROL", "*RLA", "PLP", "AND",  "ROL",  "*ANC", "BIT",  "AND", "ROL", "*RLA",  // 2
+    "BMI",  "AND", "*JAM", "*RLA", "*NOP", "AND", "ROL", "*RLA", "SEC", "AND",  "*NOP", "*RLA", "*NOP", "AND", "ROL", "*RLA",  // 3
+    "RTI",  "EOR", "*JAM", "*SRE", "*NOP", "EOR", "LSR", "*SRE", "PHA", "EOR",  "LSR",  "*ALR", "JMP",  "EOR", "LSR", "*SRE",  // 4
+    "BVC",  "EOR", "*JAM", "*SRE", "*NOP", "EOR", "LSR", "*SRE", "CLI", "EOR",  "*NOP", "*SRE", "*NOP", "EOR", "LSR", "*SRE",  // 5
+    "RTS",  "ADC", "*JAM", "*RRA", "*NOP", "ADC", "ROR", "*RRA", "PLA", "ADC",  "ROR",  "*ARR", "JMP",  "ADC", "ROR", "*RRA",  // 6
+    "BVS",  "ADC", "*JAM", "*RRA", "*NOP", "ADC", "ROR", "*RRA", "SEI", "ADC",  "*NOP", "*RRA", "*NOP", "ADC", "ROR", "*RRA",  // 7
+    "*NOP", "STA", "*NOP", "*SAX", "STY",  "STA", "STX", "*SAX", "DEY", "*NOP", "TXA",  "*XAA", "STY",  "STA", "STX", "*SAX",  // 8
+    "BCC",  "STA", "*JAM", "*AHX", "STY",  "STA", "STX", "*SAX", "TYA", "STA",  "TXS",  "*TAS", "*SHY", "STA", "*SHX", "*AHX",  // 9
+    "LDY",  "LDA", "LDX",  "*LAX", "LDY",  "LDA", "LDX", "*LAX", "TAY", "LDA",  "TAX",  "*LAX", "LDY",  "LDA", "LDX", "*LAX",  // A
+    "BCS",  "LDA", "*JAM", "*LAX", "LDY",  "LDA", "LDX", "*LAX", "CLV", "LDA",  "TSX",  "*LAS", "LDY",  "LDA", "LDX", "*LAX",  // B
+    "CPY",  "CMP", "*NOP", "*DCP", "CPY",  "CMP", "DEC", "*DCP", "INY", "CMP",  "DEX",  "*AXS", "CPY",  "CMP", "DEC", "*DCP",  // C
+    "BNE",  "CMP", "*JAM", "*DCP", "*NOP", "CMP", "DEC", "*DCP", "CLD", "CMP",  "*NOP", "*DCP", "*NOP", "CMP", "DEC", "*DCP",  // D
+    "CPX",  "SBC", "*NOP", "*ISB", "CPX",  "SBC", "INC", "*ISB", "INX", "SBC",  "NOP",  "*SBC", "CPX",  "SBC", "INC", "*ISB",  // E
+    "BEQ",  "SBC", "*JAM", "*ISB", "*NOP", "SBC", "INC", "*ISB", "SED", "SBC",  "*NOP", "*ISB", "*NOP", "SBC", "INC", "*ISB",  // F
+};
+
+constexpr auto impl = Implicit;
+constexpr auto acc  = Accumulator;
+constexpr auto imm  = Immediate;
+constexpr auto zp   = ZeroPage;
+constexpr auto zpx  = ZeroPageX;
+constexpr auto zpy  = ZeroPageY;
+constexpr auto rel  = Relative;
+constexpr auto ab   = Absolute;
+constexpr auto abx  = AbsoluteX;
+constexpr auto aby  = AbsoluteY;
+constexpr auto ind  = Indirect;
+constexpr auto indx = IndirectX;
+constexpr auto indy = IndirectY;
+
+// These are the modes as the operand is written out, so the variants
+// that only differ in timing (AbsoluteX_Exception...) never show up here
+constexpr std::array<addressing_mode::addressing_mode, 0x100> modes = {
+    // 0  1     2     3     4     5     6     7     8     9     A     B     C     D     E     F
+    impl, indx, impl, indx, zp,   zp,   zp,   zp,   impl, imm,  acc,  imm,  ab,   ab,   ab,   ab,   // 0
+    rel,  indy, impl, indy, zpx,  zpx,  zpx,  zpx,  impl, aby,  impl, aby,  abx,  abx,  abx,  abx,  // 1
+    ab,   indx, impl, indx, zp,   zp,   zp,   zp,   impl, imm,  acc,  imm,  ab,   ab,   ab,   ab,   // 2
+    rel,  indy, impl, indy, zpx,  zpx,  zpx,  zpx,  impl, aby,  impl, aby,  abx,  abx,  abx,  abx,  // 3
+    impl, indx, impl, indx, zp,   zp,   zp,   zp,   impl, imm,  acc,  imm,  ab,   ab,   ab,   ab,   // 4
+    rel,  indy, impl, indy, zpx,  zpx,  zpx,  zpx,  impl, aby,  impl, aby,  abx,  abx,  abx,  abx,  // 5
+    impl, indx, impl, indx, zp,   zp,   zp,   zp,   impl, imm,  acc,  imm,  ind,  ab,   ab,   ab,   // 6
+    rel,  indy, impl, indy, zpx,  zpx,  zpx,  zpx,  impl, aby,  impl, aby,  abx,  abx,  abx,  abx,  // 7
+    imm,  indx, imm,  indx, zp,   zp,   zp,   zp,   impl, imm,  impl, imm,  ab,   ab,   ab,   ab,   // 8
+    rel,  indy, impl, indy, zpx,  zpx,  zpy,  zpy,  impl, aby,  impl, aby,  abx,  abx,  aby,  aby,  // 9
+    imm,  indx, imm,  indx, zp,   zp,   zp,   zp,   impl, imm,  impl, imm,  ab,   ab,   ab,   ab,   // A
+    rel,  indy, impl, indy, zpx,  zpx,  zpy,  zpy,  impl, aby,  impl, aby,  abx,  abx,  aby,  aby,  // B
+    imm,  indx, imm,  indx, zp,   zp,   zp,   zp,   impl, imm,  impl, imm,  ab,   ab,   ab,   ab,   // C
+    rel,  indy, impl, indy, zpx,  zpx,  zpx,  zpx,  impl, aby,  impl, aby,  abx,  abx,  abx,  abx,  // D
+    imm,  indx, imm,  indx, zp,   zp,   zp,   zp,   impl, imm,  impl, imm,  ab,   ab,   ab,   ab,   // E
+    rel,  indy, impl, indy, zpx,  zpx,  zpx,  zpx,  impl, aby,  impl, aby,  abx,  abx,  abx,  abx,  // F
+};
+// clang-format on
+
+constexpr std::array<std::string_view, Invalid + 1> mode_names = {
+    "Implicit",
+    "Accumulator",
+    "Immediate",
+    "ZeroPage",
+    "ZeroPageX",
+    "ZeroPageY",
+    "Relative",
+    "Absolute",
+    "AbsoluteX",
+    "AbsoluteX",
+    "AbsoluteY",
+    "AbsoluteY",
+    "Indirect",
+    "IndirectX",
+    "IndirectY",
+    "IndirectY",
+    "Invalid"};
+}  // namespace
+
+std::string_view mnemonic(const uint8_t opcode)
+{
+  return mnemonics[opcode];
+}
+
+std::string_view mode_name(const addressing_mode::addressing_mode mode)
+{
+  return mode_names[mode];
+}
+
+addressing_mode::addressing_mode mode(const uint8_t opcode)
+{
+  return modes[opcode];
+}
+
+}  // namespace opcodes
+}  // namespace nes
@@ -1,23 +1,1241 @@
 #include "ppu.h"
 
+#include <algorithm>
+#include <cstring>
+
 #include "bus.h"
+#include "log.h"
+#include "render_thread.h"
 #include "types.h"
 
 namespace nes {
-void ppu::set_bus(nes::bus&) {}
+namespace {
+constexpr int dots_per_line   = 341;
+constexpr int lines_per_frame = 262;
+constexpr int dots_per_frame  = dots_per_line * lines_per_frame;
+
+constexpr int visible_lines  = 240;
+constexpr int vblank_line    = 241;
+constexpr int prerender_line = 261;
+
+constexpr int render_dot     = 1;
+constexpr int horizontal_dot = 257;
+constexpr int vertical_dot   = 304;
+constexpr int skipped_dot    = 339;
+
+constexpr int width = frame::width;
+
+// Rows of tiles in a nametable, the attribute table takes the rest
+constexpr int layer_rows = 30;
+constexpr int page_size  = width * layer_rows * 8;
+
+constexpr uint64_t ones = 0x0101010101010101;
+
+// Spreads the bits of a pattern table byte over the bytes of a row, the
+// leftmost pixel (bit 7) going to the low byte, or to the high one when
+// flipped
+constexpr std::array<uint64_t, 0x100> spread(const bool flipped)
+{
+  std::array<uint64_t, 0x100> table{};
+
+  for (size_t value = 0; value < table.size(); ++value) {
+    for (size_t bit = 0; bit < 8; ++bit) {
+      if (value & (0x80 >> bit)) {
+        table[value] |= uint64_t{1} << ((flipped ? 7 - bit : bit) * 8);
+      }
+    }
+  }
+
+  return table;
+}
+
+constexpr auto spread_bits    = spread(false);
+constexpr auto spread_flipped = spread(true);
+
+// What a hidden layer shows
+constexpr std::array<uint8_t, width> blank{};
+
+// The palette bits a nametable's attribute table has for one of its tiles
+uint8_t attribute_bits(const uint8_t* table, const int column, const int row)
+{
+  const uint8_t attribute = table[0x3C0 + (row / 4) * 8 + column / 4];
+  return (attribute >> (((row & 2) << 1) | (column & 2))) & 3;
+}
+}  // namespace
+
+void ppu::set_bus(nes::bus& ref)
+{
+  this->bus = &ref;
+}
+
+void ppu::set_render_thread(nes::render_thread* value)
+{
+  renderer = value;
+}
+
+void ppu::power_on()
+{
+  if (renderer) {
+    renderer->record(synced, ppu_input::PowerOn);
+  }
+
+  scanline  = 0;
+  dot       = 0;
+  odd_frame = false;
+
+  ctrl     = 0;
+  mask     = 0;
+  status   = 0;
+  oam_addr = 0;
+  latch    = 0;
+
+  vram_addr    = 0;
+  temp_addr    = 0;
+  fine_x       = 0;
+  write_toggle = false;
+  read_buffer  = 0;
+
+  vram.fill(0);
+  palette.fill(0);
+
+  sprite0_dot   = -1;
+  hit_predicted = false;
+  sprites_valid = false;
+  line_drawn    = false;
+  dot_mode      = false;
+
+  frames.assign(2, nes::frame{});
+  drawing = 0;
+  tile_rows.assign(tile_valid.size() * 16, 0);
+  tile_valid.reset();
+
+  layer.assign(vram.size() / 0x400 * page_size, 0);
+  layer_stale.set();
+  chr_stale.reset();
+  layer_live  = false;
+  layer_table = 0;
+
+  kernels = &compositor::best();
+
+  // The log isn't for the render thread to write to
+  if (!replaying) {
+    LOG(log::Info) << "Compositing lines with the " << kernels->name
+                   << " kernel";
+  }
+}
+
+void ppu::reset()
+{
+  if (renderer) {
+    renderer->record(synced, ppu_input::Reset);
+  }
+
+  ctrl          = 0;
+  mask          = 0;
+  write_toggle  = false;
+  read_buffer   = 0;
+  odd_frame     = false;
+  hit_predicted = false;
+}
+
+uint8_t ppu::read(const uint16_t addr)
+{
+  using namespace memory;
+
+  switch (addr % 8) {
+    case PPUSTATUS: {
+      if (renderer && ((status & 0x80) || write_toggle)) {
+        renderer->record(synced, ppu_input::Read, addr);
+      }
+
+      const uint8_t value = (status & 0xE0) | (latch & 0x1F);
+      status &= ~0x80;
+      write_toggle = false;
+      return value;
+    }
+    case OAMDATA: return oam[oam_addr];
+    case PPUDATA: {
+      if (renderer) {
+        renderer->record(synced, ppu_input::Read, addr);
+      }
+
+      this->before_change();
+      hit_predicted = false;
+
+      uint8_t value = read_buffer;
+
+      // Palette reads skip the buffer, which gets the nametable under it
+      if ((vram_addr & 0x3FFF) >= 0x3F00) {
+        value       = palette[palette_offset(vram_addr)];
+        read_buffer = memory_read(vram_addr - 0x1000);
+      } else {
+        read_buffer = memory_read(vram_addr);
+      }
+
+      vram_addr += (ctrl & 0x04) ? 32 : 1;
+      return value;
+    }
+    default: return latch;
+  }
+}
+
+void ppu::write(const uint16_t addr, const uint8_t value)
+{
+  using namespace memory;
+
+  if (renderer) {
+    renderer->record(synced, ppu_input::Write, addr, value);
+  }
+
+  latch         = value;
+  hit_predicted = false;
+
+  // OAM only matters from the next line on, sprites are fetched ahead
+  if (addr % 8 != OAMADDR && addr % 8 != OAMDATA) {
+    this->before_change();
+  }
+
+  switch (addr % 8) {
+    case PPUCTRL:
+      // Enabling NMIs during vblank fires one right away
+      if (!(ctrl & 0x80) && (value & 0x80) && (status & 0x80) &&
+          !replaying) {
+        this->bus->set_nmi();
+      }
+
+      // Sprites of the other size cover other lines
+      if ((ctrl ^ value) & 0x20) {
+        sprites_valid = false;
+      }
+
+      ctrl      = value;
+      temp_addr = (temp_addr & ~0x0C00) | ((value & 0x03) << 10);
+      break;
+    case PPUMASK: mask = value; break;
+    case OAMADDR: oam_addr = value; break;
+    case OAMDATA:
+      oam[oam_addr++] = value;
+      sprites_valid   = false;
+      break;
+    case PPUSCROLL:
+      if (!write_toggle) {
+        temp_addr = (temp_addr & ~0x001F) | (value >> 3);
+        fine_x    = value & 0x07;
+      } else {
+        temp_addr = (temp_addr & ~0x73E0) | ((value & 0x07) << 12) |
+                    ((value & 0xF8) << 2);
+      }
+
+      write_toggle = !write_toggle;
+      break;
+    case PPUADDR:
+      if (!write_toggle) {
+        temp_addr = (temp_addr & 0x00FF) | ((value & 0x3F) << 8);
+      } else {
+        temp_addr = (temp_addr & 0xFF00) | value;
+        vram_addr = temp_addr;
+      }
+
+      write_toggle = !write_toggle;
+      break;
+    case PPUDATA:
+      memory_write(vram_addr, value);
+      vram_addr += (ctrl & 0x04) ? 32 : 1;
+      break;
+  }
+}
+
+// Mappers set the mirroring again on every register write, the slots are
+// only pointed elsewhere when it changes
+void ppu::set_mirroring(const int mode)
+{
+  if (mode == mirroring) {
+    return;
+  }
+
+  if (renderer) {
+    renderer->record(synced, ppu_input::Mirroring, 0, mode);
+  }
+
+  this->before_change();
+  hit_predicted = false;
+
+  // The 1 KB page of VRAM each slot shows
+  std::array<size_t, 4> pages{};
+
+  switch (mode) {
+    case mirroring::Vertical: pages = {0, 1, 0, 1}; break;
+    case mirroring::SingleLower: pages = {0, 0, 0, 0}; break;
+    case mirroring::SingleUpper: pages = {1, 1, 1, 1}; break;
+    case mirroring::FourScreen: pages = {0, 1, 2, 3}; break;
+    default: pages = {0, 0, 1, 1}; break;
+  }
+
+  for (size_t slot = 0; slot < nametables.size(); ++slot) {
+    nametables[slot] = &vram[pages[slot] * 0x400];
+  }
+
+  mirroring = mode;
+}
+
+// A whole page written through OAMDATA, starting at OAMADDR
+void ppu::oam_dma(const uint8_t* data)
+{
+  if (renderer) {
+    renderer->record(synced, ppu_input::OAM_DMA, 0, data, oam.size());
+  }
+
+  for (size_t i = 0; i < oam.size(); ++i) {
+    oam[(oam_addr + i) & 0xFF] = data[i];
+  }
+
+  sprites_valid = false;
+  hit_predicted = false;
+}
+
+// Mappers point the PPU at their CHR banks to be read from directly, and
+// written when they're RAM. So does the render thread at its copies of them
+void ppu::map_chr(
+    const uint16_t addr,
+    const size_t   size,
+    const uint8_t* read,
+    uint8_t*       write)
+{
+  for (size_t offset = 0; offset < size; offset += 0x400) {
+    const size_t   slot = (addr + offset) >> 10;
+    const uint8_t* bank = read + offset;
+
+    if (renderer && chr_banks[slot] != bank) {
+      renderer->record_bank(synced, static_cast<uint16_t>(slot * 0x400), bank,
+                            write != nullptr);
+    }
+
+    chr_banks[slot]  = bank;
+    chr_writes[slot] = write ? write + offset : nullptr;
+  }
+}
+
+void ppu::chr_changed(const uint16_t addr, const size_t size)
+{
+  this->before_change();
+
+  for (size_t tile = addr / 16; tile < (addr + size + 15) / 16; ++tile) {
+    tile_valid.reset(tile);
+    chr_stale.set(tile);
+  }
+
+  layer_live    = false;
+  hit_predicted = false;
+}
+
+//
+// Pattern table cache
+//
+
+// Row of the tile at the given pattern table address
+uint64_t ppu::pattern_row(const uint16_t addr, const int row, const bool flip)
+{
+  const size_t tile = (addr / 16) & 0x1FF;
+
+  if (!tile_valid[tile]) {
+    this->decode_tile(tile);
+  }
+
+  return tile_rows[tile * 16 + (flip ? 8 : 0) + row];
+}
+
+void ppu::decode_tile(const size_t tile)
+{
+  const uint8_t* chr  = chr_banks[tile / 64] + (tile % 64) * 16;
+  uint64_t*      rows = &tile_rows[tile * 16];
+
+  for (size_t row = 0; row < 8; ++row) {
+    const uint8_t low  = chr[row];
+    const uint8_t high = chr[row + 8];
+
+    rows[row]     = spread_bits[low] | (spread_bits[high] << 1);
+    rows[row + 8] = spread_flipped[low] | (spread_flipped[high] << 1);
+  }
+
+  tile_valid.set(tile);
+}
+
+//
+// PPU memory
+//
+
+uint8_t ppu::memory_read(uint16_t addr)
+{
+  addr &= 0x3FFF;
+
+  if (addr < 0x2000) {
+    return chr_banks[addr >> 10][addr & 0x3FF];
+  } else if (addr < 0x3F00) {
+    return nametable(addr);
+  } else {
+    return palette[palette_offset(addr)];
+  }
+}
+
+void ppu::memory_write(uint16_t addr, const uint8_t value)
+{
+  addr &= 0x3FFF;
+
+  if (addr < 0x2000) {
+    uint8_t* bank = chr_writes[addr >> 10];
+
+    // Writes to CHR ROM go nowhere. RAM is written through the bank the
+    // slot shows, the one the PPU reads
+    if (bank) {
+      this->chr_changed(addr, 1);
+      bank[addr & 0x3FF] = value;
+    }
+  } else if (addr < 0x3F00) {
+    uint8_t&     byte   = nametable(addr);
+    const size_t offset = &byte - vram.data();
+    const size_t page   = offset / 0x400;
+    const size_t index  = offset % 0x400;
+
+    byte = value;
+
+    // An attribute byte covers four rows of tiles
+    if (index < 0x3C0) {
+      layer_stale.set(page * layer_rows + index / 32);
+    } else {
+      const size_t top = (index - 0x3C0) / 8 * 4;
+
+      for (size_t row = top; row < std::min<size_t>(top + 4, layer_rows);
+           ++row) {
+        layer_stale.set(page * layer_rows + row);
+      }
+    }
+  } else {
+    palette[palette_offset(addr)] = value & 0x3F;
+  }
+}
+
+// Two 1 KB nametables in the console, mirrored over four
+// $3000-$3EFF mirror the slots too
+uint8_t& ppu::nametable(const uint16_t addr)
+{
+  return nametables[(addr >> 10) & 3][addr & 0x3FF];
+}
+
+// 0x3F10, 0x3F14, 0x3F18 and 0x3F1C are the background entries
+uint8_t ppu::palette_offset(const uint16_t addr) const
+{
+  const uint8_t offset = addr & 0x1F;
+  return (offset & 0x13) == 0x10 ? offset & 0x0F : offset;
+}
+
+//
+// Scrolling, see https://wiki.nesdev.com/w/index.php/PPU_scrolling
+//
+
+bool ppu::rendering() const
+{
+  return mask & 0x18;
+}
+
+void ppu::increment_x()
+{
+  if ((vram_addr & 0x1F) == 31) {
+    vram_addr = (vram_addr & ~0x1F) ^ 0x0400;
+  } else {
+    ++vram_addr;
+  }
+}
+
+void ppu::increment_y()
+{
+  if ((vram_addr & 0x7000) != 0x7000) {
+    vram_addr += 0x1000;
+    return;
+  }
+
+  vram_addr &= ~0x7000;
+  int coarse_y = (vram_addr & 0x03E0) >> 5;
+
+  if (coarse_y == 29) {
+    coarse_y = 0;
+    vram_addr ^= 0x0800;
+  } else if (coarse_y == 31) {
+    coarse_y = 0;
+  } else {
+    ++coarse_y;
+  }
+
+  vram_addr = (vram_addr & ~0x03E0) | (coarse_y << 5);
+}
+
+void ppu::copy_horizontal()
+{
+  vram_addr = (vram_addr & ~0x041F) | (temp_addr & 0x041F);
+}
+
+void ppu::copy_vertical()
+{
+  vram_addr = (vram_addr & ~0x7BE0) | (temp_addr & 0x7BE0);
+}
+
+//
+// Rendering. A whole line is drawn at once as it starts, with the
+// registers as they are then. Lines that change midway are drawn again from
+// there one dot at a time
+//
+
+void ppu::render_line()
+{
+  sprite0_dot = -1;
+  line_drawn  = this->rendering();
+
+  // With a render thread drawing the line, only what the CPU sees of it is
+  // worked out
+  if (renderer) {
+    if (line_drawn) {
+      this->evaluate_line();
+    }
+
+    return;
+  }
+
+  nes::frame& target = frames[drawing];
+  uint8_t*    out    = &target.pixels[scanline * width];
+
+  const uint8_t grayscale = (mask & 0x01) ? 0x30 : 0x3F;
+
+  target.emphasis[scanline] = mask >> 5;
+
+  if (!line_drawn) {
+    std::fill(out, out + width, palette[0] & grayscale);
+    return;
+  }
+
+  // Both layers are kept whole even when hidden, the dot path may need them
+  this->render_background();
+  this->render_sprites();
+
+  const uint8_t* background =
+      (mask & 0x08) ? &line_background[fine_x] : blank.data();
+  const uint8_t* sprites = (mask & 0x10) ? line_sprites.data() : blank.data();
+
+  // The line is merged straight into the frame, then its palette indexes
+  // are replaced with the colours they hold
+  const int hit = kernels->composite(background, sprites, out, !(mask & 0x02),
+                                     !(mask & 0x04));
+
+  if (hit >= 0 && !(status & 0x40)) {
+    sprite0_dot = hit + 1;
+  }
+
+  std::array<uint8_t, 0x20> line_colors;
+
+  for (size_t i = 0; i < line_colors.size(); ++i) {
+    line_colors[i] = palette[i] & grayscale;
+  }
+
+  for (int x = 0; x < width; ++x) {
+    out[x] = line_colors[out[x]];
+  }
+}
+
+// Whether the line just drawn changed since the last frame, so the ones
+// presenting the frame can skip what they already have
+void ppu::compare_line()
+{
+  if (renderer) {
+    return;
+  }
+
+  const nes::frame& previous = frames[drawing ^ 1];
+  nes::frame&       current  = frames[drawing];
+  const size_t      start    = scanline * width;
+
+  current.dirty[scanline] =
+      current.emphasis[scanline] != previous.emphasis[scanline] ||
+      std::memcmp(&current.pixels[start], &previous.pixels[start], width);
+}
+
+// The 8 pixels of the tile at a VRAM address, the row given by its fine Y
+uint64_t ppu::tile_span(const uint16_t addr)
+{
+  return this->tile_row(nametable(addr), this->tile_attribute(addr),
+                        (addr >> 12) & 7);
+}
+
+// The palette bits the attribute table has for the tile at a VRAM address
+uint8_t ppu::tile_attribute(const uint16_t addr)
+{
+  return attribute_bits(nametables[(addr >> 10) & 3], addr & 0x1F,
+                        (addr >> 5) & 0x1F);
+}
+
+// One lookup in the pattern cache, and the attribute goes onto the opaque
+// pixels of the row all at once
+uint64_t ppu::tile_row(const uint8_t index, const uint8_t attribute,
+                       const int row)
+{
+  const uint64_t pixels =
+      this->pattern_row(((ctrl & 0x10) << 8) + index * 16, row, false);
+  const uint64_t opaque = (pixels | (pixels >> 1)) & ones;
+
+  return pixels | opaque * (attribute << 2);
+}
+
+// 33 tiles from the one vram_addr points at, eight pixels to spare on the
+// right for the fine scroll. They're copied out of the layer, from the
+// nametable v is in and the one to its right, unless the layer can't be
+// used for the line
+void ppu::render_background()
+{
+  const int coarse_x = vram_addr & 0x1F;
+  const int coarse_y = (vram_addr >> 5) & 0x1F;
 
-void ppu::power_on() {}
+  if (layer_live && (ctrl & 0x10) == layer_table && coarse_y < layer_rows) {
+    const int    slot  = (vram_addr >> 10) & 3;
+    const int    line  = coarse_y * 8 + ((vram_addr >> 12) & 7);
+    const size_t split = (32 - coarse_x) * 8;
 
-void ppu::reset() {}
+    const uint8_t* left = this->layer_line(nametables[slot], coarse_y, line);
+    const uint8_t* right =
+        this->layer_line(nametables[slot ^ 1], coarse_y, line);
 
-uint8_t ppu::read(const uint16_t)
+    std::memcpy(&line_background[0], left + coarse_x * 8, split);
+    std::memcpy(&line_background[split], right,
+                line_background.size() - split);
+    return;
+  }
+
+  const uint16_t saved = vram_addr;
+
+  for (size_t tile = 0; tile < 33; ++tile) {
+    const uint64_t span = this->tile_span(vram_addr);
+    std::memcpy(&line_background[tile * 8], &span, sizeof(span));
+    this->increment_x();
+  }
+
+  vram_addr = saved;
+}
+
+// A line of the layer of the page a nametable slot shows, its row of tiles
+// drawn again first if stale
+const uint8_t* ppu::layer_line(const uint8_t* table, const int row,
+                               const int line)
+{
+  const size_t page = (table - vram.data()) / 0x400;
+
+  if (layer_stale[page * layer_rows + row]) {
+    this->render_layer_row(page, row);
+  }
+
+  return &layer[page * page_size + line * width];
+}
+
+void ppu::render_layer_row(const size_t page, const int row)
+{
+  const uint8_t* table = &vram[page * 0x400];
+  uint8_t*       out   = &layer[page * page_size + row * 8 * width];
+
+  for (int column = 0; column < 32; ++column) {
+    const uint8_t index     = table[row * 32 + column];
+    const uint8_t attribute = attribute_bits(table, column, row);
+
+    for (int y = 0; y < 8; ++y) {
+      const uint64_t span = this->tile_row(index, attribute, y);
+      std::memcpy(&out[y * width + column * 8], &span, sizeof(span));
+    }
+  }
+
+  layer_stale.reset(page * layer_rows + row);
+}
+
+// As a frame starts, the rows with tiles whose CHR changed since the last
+// one go stale, or all of them if the background moved to the other
+// pattern table
+void ppu::refresh_layer()
+{
+  if ((ctrl & 0x10) != layer_table) {
+    layer_table = ctrl & 0x10;
+    layer_stale.set();
+  } else if (chr_stale.any()) {
+    const size_t first = layer_table ? 0x100 : 0;
+
+    for (size_t page = 0; page < vram.size() / 0x400; ++page) {
+      for (size_t tile = 0; tile < layer_rows * 32; ++tile) {
+        if (chr_stale[first + vram[page * 0x400 + tile]]) {
+          layer_stale.set(page * layer_rows + tile / 32);
+        }
+      }
+    }
+  }
+
+  chr_stale.reset();
+  layer_live = true;
+}
+
+// The sprites evaluation found on the line, lower indexes in front
+void ppu::render_sprites()
+{
+  if (!sprites_valid) {
+    this->evaluate_sprites();
+  }
+
+  const sprite_line& line = sprite_lines[scanline];
+  uint8_t*           out  = line_sprites.data();
+
+  // Sprites are evaluated even when hidden, the overflow flag still works
+  if (line.overflow) {
+    status |= 0x20;
+  }
+
+  line_sprites.fill(0);
+
+  for (int n = 0; n < line.count; ++n) {
+    const int      i      = line.sprites[n];
+    const uint8_t* sprite = &oam[i * 4];
+
+    const uint8_t  attributes = sprite[2];
+    const int      x          = sprite[3];
+    const uint64_t pixels     = this->sprite_row(sprite, scanline);
+    const uint8_t  flags      = 0x10 | ((attributes & 3) << 2) |
+                              (attributes & 0x20 ? sprite_pixel::Behind : 0) |
+                              (i == 0 ? sprite_pixel::Zero : 0);
+
+    for (int p = 0; p < 8 && x + p < width; ++p) {
+      const uint8_t pixel = (pixels >> (p * 8)) & 3;
+
+      if (pixel && !out[x + p]) {
+        out[x + p] = flags | pixel;
+      }
+    }
+  }
+}
+
+// The row of a sprite's pattern on a line it's on, flipped as its attributes
+// say
+uint64_t ppu::sprite_row(const uint8_t* sprite, const int line)
+{
+  const int     size       = (ctrl & 0x20) ? 16 : 8;
+  const uint8_t tile       = sprite[1];
+  const uint8_t attributes = sprite[2];
+  int           row        = line - sprite[0] - 1;
+
+  if (attributes & 0x80) {
+    row = size - 1 - row;
+  }
+
+  uint16_t addr = 0;
+
+  if (size == 16) {
+    addr = ((tile & 1) << 12) | ((tile & 0xFE) << 4) | ((row & 8) << 1);
+  } else {
+    addr = ((ctrl & 0x08) << 9) | (tile << 4);
+  }
+
+  return this->pattern_row(addr, row & 7, attributes & 0x40);
+}
+
+// What drawing the line would tell the CPU, without drawing it: whether
+// evaluating it sets the overflow flag, and where sprite 0 hits. The hit is
+// looked for in the two tiles under the sprite, as predictions are
+void ppu::evaluate_line()
+{
+  if (!sprites_valid) {
+    this->evaluate_sprites();
+  }
+
+  const sprite_line& line = sprite_lines[scanline];
+
+  if (line.overflow) {
+    status |= 0x20;
+  }
+
+  // Sprite 0 is first on the lines it's on
+  if ((mask & 0x18) != 0x18 || (status & 0x40) || !line.count ||
+      line.sprites[0] != 0) {
+    return;
+  }
+
+  const int hit = this->line_hit(scanline);
+
+  if (hit >= 0) {
+    sprite0_dot = hit + 1;
+  }
+}
+
+// Sorts all of OAM out by line at once, as the PPU would evaluate it on
+// each. Sprite Y is the line before the first one the sprite is on
+void ppu::evaluate_sprites()
+{
+  const int size = (ctrl & 0x20) ? 16 : 8;
+
+  for (auto& line : sprite_lines) {
+    line.count    = 0;
+    line.overflow = false;
+  }
+
+  for (int i = 0; i < 64; ++i) {
+    const int top    = oam[i * 4] + 1;
+    const int bottom = std::min(top + size, visible_lines);
+
+    for (int y = top; y < bottom; ++y) {
+      sprite_line& line = sprite_lines[y];
+
+      if (line.count < 8) {
+        line.sprites[line.count++] = static_cast<uint8_t>(i);
+      }
+    }
+  }
+
+  // Once 8 sprites are found, the PPU goes on to the next sprite and to the
+  // next byte of it at once whenever one isn't on the line. It ends up
+  // taking tiles, attributes and X for Y, as the hardware does, so the
+  // flag can be set without a 9th sprite or missed with one
+  for (int y = 0; y < visible_lines; ++y) {
+    sprite_line& line = sprite_lines[y];
+
+    if (line.count < 8) {
+      continue;
+    }
+
+    int byte = 0;
+
+    for (int i = line.sprites[7] + 1; i < 64; ++i) {
+      const int row = y - oam[i * 4 + byte] - 1;
+
+      if (row >= 0 && row < size) {
+        line.overflow = true;
+        break;
+      }
+
+      byte = (byte + 1) & 3;
+    }
+  }
+
+  sprites_valid = true;
+}
+
+// Looks for the next sprite 0 hit before the frame ends, with v stepped
+// through the lines ahead as the PPU will. Only the background under the
+// sprite is fetched
+void ppu::predict_hit()
+{
+  hit_predicted  = true;
+  predicted_line = -1;
+
+  if ((mask & 0x18) != 0x18 || (status & 0x40) ||
+      (scanline >= visible_lines && scanline != prerender_line)) {
+    return;
+  }
+
+  const uint16_t saved  = vram_addr;
+  const int      size   = (ctrl & 0x20) ? 16 : 8;
+  const int      top    = oam[0] + 1;
+  const int      bottom = std::min(top + size, visible_lines);
+
+  int line = scanline;
+
+  if (scanline == prerender_line) {
+    if (dot <= horizontal_dot) {
+      this->copy_horizontal();
+    }
+
+    if (dot <= vertical_dot) {
+      this->copy_vertical();
+    }
+
+    line = 0;
+  } else if (dot > render_dot) {
+    // The line is drawn, whatever it hits is in sprite0_dot already
+    if (dot <= horizontal_dot) {
+      this->increment_y();
+      this->copy_horizontal();
+    }
+
+    ++line;
+  }
+
+  for (; line < bottom; ++line) {
+    const int x = line >= top ? this->line_hit(line) : -1;
+
+    if (x >= 0) {
+      predicted_line = line;
+      predicted_dot  = x + 1;
+      break;
+    }
+
+    this->increment_y();
+    this->copy_horizontal();
+  }
+
+  vram_addr = saved;
+}
+
+// First x at which sprite 0 hits the background on a line, v at its start,
+// -1 if it doesn't
+int ppu::line_hit(const int line)
+{
+  const uint8_t* sprite = &oam[0];
+  const uint64_t pixels = this->sprite_row(sprite, line);
+  const int      left   = sprite[3];
+  const int      first  = (left + fine_x) / 8;
+  const uint16_t saved  = vram_addr;
+
+  // The two tiles under the sprite
+  for (int i = 0; i < first; ++i) {
+    this->increment_x();
+  }
+
+  std::array<uint64_t, 2> spans{};
+  spans[0] = this->tile_span(vram_addr);
+  this->increment_x();
+  spans[1] = this->tile_span(vram_addr);
+
+  vram_addr = saved;
+
+  std::array<uint8_t, 16> background{};
+  std::memcpy(background.data(), spans.data(), background.size());
+
+  const bool clipped = !(mask & 0x02) || !(mask & 0x04);
+
+  for (int p = 0; p < 8 && left + p < width - 1; ++p) {
+    const int x = left + p;
+
+    if ((x < 8 && clipped) || !((pixels >> (p * 8)) & 3)) {
+      continue;
+    }
+
+    if (background[x + fine_x - first * 8] & 3) {
+      return x;
+    }
+  }
+
+  return -1;
+}
+
+// Something the rest of the line depends on is about to change. If the line
+// is already drawn, the part of it still to come is drawn again one dot at a
+// time from here on
+void ppu::before_change()
+{
+  if (dot_mode || !line_drawn || scanline >= visible_lines ||
+      dot <= render_dot || dot >= horizontal_dot) {
+    return;
+  }
+
+  dot_mode = true;
+  line_dot = dot;
+
+  // Lines the render thread draws have no layers yet, they're taken from
+  // the registers the line started with, which are still the same
+  if (renderer) {
+    this->render_background();
+    this->render_sprites();
+  }
+
+  // Where the hardware's v is by now: two tiles ahead from the fetches at
+  // the end of the line before, and a tile further every 8 dots
+  for (int i = 0; i < 2 + (dot - 1) / 8; ++i) {
+    this->increment_x();
+  }
+
+  // The fetch in progress may have read some of the tile already
+  fetch_index     = nametable(vram_addr);
+  fetch_attribute = this->tile_attribute(vram_addr);
+
+  // A hit still to come may not happen anymore, the dot path finds it again
+  if (sprite0_dot >= dot) {
+    sprite0_dot = -1;
+  }
+}
+
+// Draws the dots up to the given one. The tile two ahead of the one being
+// drawn is fetched over the 8 dots before, its index, attribute and pattern
+// read with the registers as they are by then, and v moves on to the next
+void ppu::render_dots(const int to)
+{
+  for (; line_dot < to; ++line_dot) {
+    if (this->rendering() && line_dot <= 248) {
+      switch (line_dot & 7) {
+        case 1: fetch_index = nametable(vram_addr); break;
+        case 3: fetch_attribute = this->tile_attribute(vram_addr); break;
+        case 5: {
+          const uint64_t span = this->tile_row(fetch_index, fetch_attribute,
+                                               (vram_addr >> 12) & 7);
+          std::memcpy(&line_background[((line_dot - 1) / 8 + 2) * 8], &span,
+                      sizeof(span));
+          break;
+        }
+      }
+    }
+
+    this->render_pixel(line_dot - 1);
+
+    if (this->rendering() && (line_dot & 7) == 0) {
+      this->increment_x();
+    }
+  }
+}
+
+// What the compositing kernels do for a line, for a single pixel. Emphasis
+// stays the one the line started with
+void ppu::render_pixel(const int x)
+{
+  const bool left   = x < 8;
+  uint8_t    back   = 0;
+  uint8_t    sprite = 0;
+
+  if ((mask & 0x08) && (!left || (mask & 0x02))) {
+    back = line_background[x + fine_x];
+  }
+
+  if ((mask & 0x10) && (!left || (mask & 0x04))) {
+    sprite = line_sprites[x];
+  }
+
+  if (back && (sprite & sprite_pixel::Zero) && x != width - 1) {
+    status |= 0x40;
+  }
+
+  uint8_t index = back;
+
+  if (sprite && (!back || !(sprite & sprite_pixel::Behind))) {
+    index = sprite & 0x1F;
+  }
+
+  const uint8_t grayscale = (mask & 0x01) ? 0x30 : 0x3F;
+
+  frames[drawing].pixels[scanline * width + x] = palette[index] & grayscale;
+}
+
+//
+// Catch-up synchronization. The PPU only runs when somebody needs to observe
+// it, and then skips straight over the dots where nothing happens
+//
+
+uint64_t ppu::sync(const uint64_t cpu_cycle)
 {
-  return 0;
+  const uint64_t target = cpu_cycle * 3;
+
+  synced = cpu_cycle;
+
+  while (clock < target) {
+    const int until_event = dots_until_event();
+
+    if (until_event == 0) {
+      step();
+    } else {
+      advance(static_cast<int>(
+          std::min<uint64_t>(until_event, target - clock)));
+    }
+  }
+
+  // Nobody waits on the render thread's PPU
+  if (!hit_predicted && !replaying) {
+    this->predict_hit();
+  }
+
+  return next_event();
 }
 
-void ppu::write(const uint16_t, const uint8_t) {}
+// With a render thread, the frame just run goes to it, and the ones it drew
+// from the log of the one before are shown
+void ppu::end_frame()
+{
+  if (!renderer) {
+    return;
+  }
+
+  const int finished = renderer->submit(synced);
+
+  for (int i = 0; i < finished; ++i) {
+    this->bus->update_frame(renderer->output());
+  }
+}
+
+// Runs the dot at the current position
+void ppu::step()
+{
+  if (scanline < visible_lines) {
+    if (dot == render_dot) {
+      this->render_line();
+      this->compare_line();
+    }
+
+    if (sprite0_dot >= 0 && sprite0_dot <= dot) {
+      status |= 0x40;
+      sprite0_dot   = -1;
+      hit_predicted = false;
+    }
+
+    if (dot == horizontal_dot && dot_mode) {
+      dot_mode = false;
+      this->compare_line();
+    }
+
+    // Incrementing Y at dot 256 and copying X at 257 in one go
+    if (dot == horizontal_dot && this->rendering()) {
+      this->increment_y();
+      this->copy_horizontal();
+    }
+  } else if (scanline == vblank_line && dot == 1) {
+    status |= 0x80;
+
+    if (replaying) {
+      last_frame = &frames[drawing];
+      ++frames_finished;
+    } else if (!renderer) {
+      this->bus->update_frame(frames[drawing]);
+    }
 
-void ppu::set_mirroring(const int) {}
+    drawing ^= 1;
 
-void ppu::step() {}
-}  // namespace nes
\ No newline at end of file
+    if ((ctrl & 0x80) && !replaying) {
+      this->bus->set_nmi();
+    }
+  } else if (scanline == prerender_line) {
+    if (dot == 1) {
+      status &= ~0xE0;
+      hit_predicted = false;
+      this->refresh_layer();
+    } else if (dot == horizontal_dot && this->rendering()) {
+      this->copy_horizontal();
+    } else if (dot == vertical_dot && this->rendering()) {
+      this->copy_vertical();
+    } else if (dot == skipped_dot && this->rendering() && odd_frame) {
+      // Odd frames are a dot shorter, the idle dot at 0,0 goes
+      clock += 1;
+
+      scanline  = 0;
+      dot       = 0;
+      odd_frame = false;
+      return;
+    }
+  }
+
+  advance(1);
+}
+
+// Moves the position forward without running the dots in between
+void ppu::advance(const int dots)
+{
+  if (dot_mode) {
+    this->render_dots(std::min(dot + dots, horizontal_dot));
+  }
+
+  clock += dots;
+  dot += dots;
+
+  const int lines = scanline + dot / dots_per_line;
+
+  if (lines >= lines_per_frame) {
+    odd_frame = odd_frame != ((lines / lines_per_frame) % 2 == 1);
+  }
+
+  scanline = lines % lines_per_frame;
+  dot %= dots_per_line;
+}
+
+// First dot from the given one on where something happens, -1 if there's
+// none left on the line
+int ppu::event_dot(const int line, const int from) const
+{
+  int next = dots_per_line;
+
+  const auto consider = [&next, from](const int candidate) {
+    if (candidate >= from && candidate < next) {
+      next = candidate;
+    }
+  };
+
+  if (line < visible_lines) {
+    consider(render_dot);
+
+    if (line == scanline && sprite0_dot >= 0) {
+      consider(sprite0_dot);
+    }
+
+    if (this->rendering() || (line == scanline && dot_mode)) {
+      consider(horizontal_dot);
+    }
+  } else if (line == vblank_line) {
+    consider(1);
+  } else if (line == prerender_line) {
+    consider(1);
+
+    if (this->rendering()) {
+      consider(horizontal_dot);
+      consider(vertical_dot);
+
+      if (odd_frame) {
+        consider(skipped_dot);
+      }
+    }
+  }
+
+  return next == dots_per_line ? -1 : next;
+}
+
+int ppu::dots_until_event() const
+{
+  int line     = scanline;
+  int from     = dot;
+  int distance = 0;
+
+  while (true) {
+    const int next = event_dot(line, from);
+
+    if (next >= 0) {
+      return distance + next - from;
+    }
+
+    distance += dots_per_line - from;
+    line = (line + 1) % lines_per_frame;
+    from = 0;
+  }
+}
+
+// Dots from the current position to the given one, 0 if it's now
+int ppu::dots_until(const int line, const int target) const
+{
+  const int position = scanline * dots_per_line + dot;
+
+  return (line * dots_per_line + target - position + dots_per_frame) %
+         dots_per_frame;
+}
+
+// The CPU only needs to see what changes PPUSTATUS or raises an NMI: the
+// vblank edges, and the sprite 0 hit, found on the line being drawn or
+// predicted on the ones ahead
+int ppu::dots_until_status() const
+{
+  int until =
+      std::min(dots_until(vblank_line, 1), dots_until(prerender_line, 1));
+
+  if (sprite0_dot >= 0) {
+    until = std::min(until, dots_until(scanline, sprite0_dot));
+  }
+
+  if (predicted_line >= 0) {
+    until = std::min(until, dots_until(predicted_line, predicted_dot));
+  }
+
+  // The dot path only finds the hit as it gets there
+  if (dot_mode && (mask & 0x18) == 0x18 && !(status & 0x40)) {
+    const int top    = oam[0] + 1;
+    const int bottom = std::min(top + ((ctrl & 0x20) ? 16 : 8), visible_lines);
+
+    if (scanline >= top && scanline < bottom) {
+      until = std::min(until, 1);
+    }
+  }
+
+  return until;
+}
+
+// CPU cycle at which the PPU has to run again for its effects to be seen
+uint64_t ppu::next_event() const
+{
+  return (clock + dots_until_status()) / 3 + 1;
+}
+}  // namespace nes
@@ -0,0 +1,213 @@
+#include "profiler.h"
+
+#include <fstream>
+#include <stdexcept>
+
+#include <fmt/format.h>
+
+#include "opcodes.h"
+
+namespace nes {
+profiler::profiler()
+{
+  this->clear();
+}
+
+void profiler::clear()
+{
+  by_opcode  = {};
+  interrupts = {};
+  sites.clear();
+
+  nodes.assign(1, frame_node{});
+  children.clear();
+  stack.clear();
+  current = 0;
+}
+
+void profiler::instruction(
+    const uint16_t pc,
+    const int      bank,
+    const uint8_t  opcode,
+    const uint64_t cycles)
+{
+  const size_t key = bank < 0 ? pc : 0x8000 + bank * 0x2000 + (pc & 0x1FFF);
+
+  if (key >= sites.size()) {
+    sites.resize(key + 1);
+  }
+
+  auto& entry = sites[key];
+  ++entry.count;
+  entry.cycles += cycles;
+  entry.pc     = pc;
+  entry.opcode = opcode;
+
+  ++by_opcode[opcode].count;
+  by_opcode[opcode].cycles += cycles;
+
+  nodes[current].cycles += cycles;
+}
+
+// The cycles here are the ones taken to push the state and load the vector
+void profiler::interrupt(
+    const uint16_t pc,
+    const int      bank,
+    const uint8_t  sp,
+    const uint64_t cycles)
+{
+  this->call(pc, bank, sp);
+
+  ++interrupts.count;
+  interrupts.cycles += cycles;
+
+  nodes[current].cycles += cycles;
+}
+
+// Runaway code can keep calling with the stack pointer wrapping around,
+// anything deeper than max_depth stays in the frame it was called from
+void profiler::call(const uint16_t pc, const int bank, const uint8_t sp)
+{
+  if (stack.size() == max_depth) {
+    return;
+  }
+
+  const uint64_t key = uint64_t{current} << 32 |
+                       static_cast<uint64_t>(bank + 1) << 16 | pc;
+
+  auto [it, inserted] = children.try_emplace(key, nodes.size());
+
+  if (inserted) {
+    nodes.push_back({current, bank, pc, 0});
+  }
+
+  current = it->second;
+  stack.push_back({current, sp});
+}
+
+// Called with the stack pointer after RTS, RTI or TXS
+void profiler::unwind(const uint8_t sp)
+{
+  while (!stack.empty() && sp >= stack.back().sp) {
+    stack.pop_back();
+  }
+
+  current = stack.empty() ? 0 : stack.back().node;
+}
+
+void profiler::dump(const std::filesystem::path& path) const
+{
+  std::ofstream csv{path.string() + ".csv"};
+  std::ofstream folded{path.string() + ".folded"};
+
+  if (!csv || !folded) {
+    throw std::runtime_error("Can't write the profile");
+  }
+
+  this->write_csv(csv);
+  this->write_folded(folded);
+}
+
+//
+// One table, the first column says what a row counts:
+// opcode, mode, interrupt (entry sequences) or pc
+//
+
+void profiler::write_csv(std::ostream& out) const
+{
+  std::array<counter, addressing_mode::Invalid + 1> modes{};
+
+  out << "kind,bank,address,opcode,mnemonic,mode,count,cycles\n";
+
+  for (size_t opcode = 0; opcode < by_opcode.size(); ++opcode) {
+    const auto& entry = by_opcode[opcode];
+    const auto  mode  = opcodes::mode(static_cast<uint8_t>(opcode));
+
+    if (entry.count == 0) {
+      continue;
+    }
+
+    modes[mode].count += entry.count;
+    modes[mode].cycles += entry.cycles;
+
+    out << fmt::format(
+        "opcode,,,{:02X},{},{},{},{}\n",
+        opcode,
+        opcodes::mnemonic(static_cast<uint8_t>(opcode)),
+        opcodes::mode_name(mode),
+        entry.count,
+        entry.cycles);
+  }
+
+  for (size_t mode = 0; mode < modes.size(); ++mode) {
+    const auto& entry = modes[mode];
+    const auto  name =
+        opcodes::mode_name(static_cast<addressing_mode::addressing_mode>(mode));
+
+    if (entry.count == 0) {
+      continue;
+    }
+
+    out << fmt::format(
+        "mode,,,,,{},{},{}\n", name, entry.count, entry.cycles);
+  }
+
+  out << fmt::format(
+      "interrupt,,,,,,{},{}\n", interrupts.count, interrupts.cycles);
+
+  for (size_t key = 0; key < sites.size(); ++key) {
+    const auto& entry = sites[key];
+
+    if (entry.count == 0) {
+      continue;
+    }
+
+    const auto bank = key < 0x8000 ? std::string{}
+                                   : fmt::format("{}", (key - 0x8000) / 0x2000);
+
+    out << fmt::format(
+        "pc,{},{:04X},{:02X},{},{},{},{}\n",
+        bank,
+        entry.pc,
+        entry.opcode,
+        opcodes::mnemonic(entry.opcode),
+        opcodes::mode_name(opcodes::mode(entry.opcode)),
+        entry.count,
+        entry.cycles);
+  }
+}
+
+// Frames read bank:address, or just the address for code running from RAM
+void profiler::write_path(std::ostream& out, const size_t node) const
+{
+  std::vector<size_t> path;
+
+  for (size_t i = node; i != 0; i = nodes[i].parent) {
+    path.push_back(i);
+  }
+
+  out << "main";
+
+  for (auto it = path.rbegin(); it != path.rend(); ++it) {
+    const auto& entry = nodes[*it];
+
+    if (entry.bank < 0) {
+      out << fmt::format(";{:04X}", entry.pc);
+    } else {
+      out << fmt::format(";{}:{:04X}", entry.bank, entry.pc);
+    }
+  }
+}
+
+void profiler::write_folded(std::ostream& out) const
+{
+  for (size_t node = 0; node < nodes.size(); ++node) {
+    if (nodes[node].cycles == 0) {
+      continue;
+    }
+
+    this->write_path(out, node);
+    out << ' ' << nodes[node].cycles << '\n';
+  }
+}
+}  // namespace nes
@@ -0,0 +1,158 @@
+#include "render_thread.h"
+
+#include <cstring>
+
+namespace nes {
+render_thread::render_thread()
+{
+  replica.replaying = true;
+
+  worker = std::thread{&render_thread::work, this};
+}
+
+render_thread::~render_thread()
+{
+  {
+    std::lock_guard<std::mutex> lock{mutex};
+    stop = true;
+  }
+
+  wake.notify_one();
+  worker.join();
+}
+
+void render_thread::record(
+    const uint64_t             cycle,
+    const ppu_input::ppu_input type,
+    const uint16_t             addr,
+    const int                  value)
+{
+  logs[recording].entries.push_back({cycle, type, addr, value, 0, false});
+}
+
+// What goes with the entry is copied into the log, it may have changed by
+// the time the worker gets to it
+void render_thread::record(
+    const uint64_t             cycle,
+    const ppu_input::ppu_input type,
+    const uint16_t             addr,
+    const uint8_t*             data,
+    const size_t               size)
+{
+  ppu_log& log = logs[recording];
+
+  log.entries.push_back({cycle, type, addr, 0, log.bytes.size(), false});
+  log.bytes.insert(log.bytes.end(), data, data + size);
+}
+
+void render_thread::record_bank(
+    const uint64_t cycle,
+    const uint16_t addr,
+    const uint8_t* bank,
+    const bool     ram)
+{
+  const auto [it, added] =
+      banks.try_emplace(bank, static_cast<int>(banks.size()));
+
+  if (added) {
+    this->record(cycle, ppu_input::CHR_Bank, addr, bank, 0x400);
+    logs[recording].entries.back().value = it->second;
+  } else {
+    this->record(cycle, ppu_input::CHR_Bank, addr, it->second);
+  }
+
+  logs[recording].entries.back().ram = ram;
+}
+
+int render_thread::submit(const uint64_t end)
+{
+  std::unique_lock<std::mutex> lock{mutex};
+  idle.wait(lock, [this] { return !busy; });
+
+  const int count = replica.frames_finished;
+
+  if (count > 0) {
+    finished                = *replica.last_frame;
+    replica.frames_finished = 0;
+  }
+
+  logs[recording].end = end;
+  recording ^= 1;
+  logs[recording].entries.clear();
+  logs[recording].bytes.clear();
+
+  busy = true;
+  lock.unlock();
+  wake.notify_one();
+
+  return count;
+}
+
+const nes::frame& render_thread::output() const
+{
+  return finished;
+}
+
+void render_thread::work()
+{
+  while (true) {
+    std::unique_lock<std::mutex> lock{mutex};
+    wake.wait(lock, [this] { return busy || stop; });
+
+    if (stop) {
+      return;
+    }
+
+    // The CPU thread only touches the other log until this one is done
+    const ppu_log& log = logs[recording ^ 1];
+    lock.unlock();
+
+    this->replay(log);
+
+    lock.lock();
+    busy = false;
+    lock.unlock();
+    idle.notify_one();
+  }
+}
+
+// The replica runs up to each input as the other PPU did before taking it
+void render_thread::replay(const ppu_log& log)
+{
+  for (const auto& entry : log.entries) {
+    replica.sync(entry.cycle);
+
+    switch (entry.type) {
+      case ppu_input::Read: replica.read(entry.addr); break;
+      case ppu_input::Write:
+        replica.write(entry.addr, static_cast<uint8_t>(entry.value));
+        break;
+      case ppu_input::OAM_DMA: replica.oam_dma(&log.bytes[entry.data]); break;
+      case ppu_input::Mirroring: replica.set_mirroring(entry.value); break;
+      case ppu_input::CHR_Bank: this->switch_bank(log, entry); break;
+      case ppu_input::PowerOn: replica.power_on(); break;
+      case ppu_input::Reset: replica.reset(); break;
+    }
+  }
+
+  replica.sync(log.end);
+}
+
+// Banks come in the order they were numbered, a new one with its bytes
+void render_thread::switch_bank(
+    const ppu_log&        log,
+    const ppu_log::entry& entry)
+{
+  const auto index = static_cast<size_t>(entry.value);
+
+  if (index == bank_copies.size()) {
+    bank_copies.emplace_back();
+    std::memcpy(bank_copies.back().data(), &log.bytes[entry.data], 0x400);
+  }
+
+  uint8_t* bank = bank_copies[index].data();
+
+  replica.chr_changed(entry.addr, 0x400);
+  replica.map_chr(entry.addr, 0x400, bank, entry.ram ? bank : nullptr);
+}
+}  // namespace nes
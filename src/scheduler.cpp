@@ -0,0 +1,127 @@
+#include "scheduler.h"
+
+#include <utility>
+
+namespace nes {
+scheduler::scheduler()
+{
+  deadlines.fill(never);
+  position.fill(none);
+  heap.fill(event_type::FrameEnd);
+}
+
+void scheduler::schedule(
+    const event_type::event_type event,
+    const uint64_t               cycle)
+{
+  if (position[event] == none) {
+    position[event] = size;
+    heap[size]      = event;
+    ++size;
+  }
+
+  const auto old   = deadlines[event];
+  deadlines[event] = cycle;
+
+  if (cycle < old) {
+    sift_up(position[event]);
+  } else {
+    sift_down(position[event]);
+  }
+}
+
+void scheduler::cancel(const event_type::event_type event)
+{
+  const auto slot = position[event];
+
+  if (slot == none) {
+    return;
+  }
+
+  --size;
+  swap(slot, size);
+
+  position[event]  = none;
+  deadlines[event] = never;
+
+  if (slot < size) {
+    sift_up(slot);
+    sift_down(slot);
+  }
+}
+
+uint64_t scheduler::deadline(const event_type::event_type event) const
+{
+  return deadlines[event];
+}
+
+uint64_t scheduler::next() const
+{
+  return size ? deadlines[heap[0]] : never;
+}
+
+event_type::event_type scheduler::top() const
+{
+  return heap[0];
+}
+
+//
+// Heap
+//
+
+// Ties go to the lower event type, so simultaneous events keep their order
+bool scheduler::before(const size_t a, const size_t b) const
+{
+  const auto x = heap[a];
+  const auto y = heap[b];
+
+  return deadlines[x] < deadlines[y] ||
+         (deadlines[x] == deadlines[y] && x < y);
+}
+
+void scheduler::swap(const size_t a, const size_t b)
+{
+  std::swap(heap[a], heap[b]);
+
+  position[heap[a]] = a;
+  position[heap[b]] = b;
+}
+
+void scheduler::sift_up(size_t slot)
+{
+  while (slot > 0) {
+    const auto parent = (slot - 1) / 2;
+
+    if (!before(slot, parent)) {
+      break;
+    }
+
+    swap(slot, parent);
+    slot = parent;
+  }
+}
+
+void scheduler::sift_down(size_t slot)
+{
+  while (true) {
+    const auto left  = 2 * slot + 1;
+    const auto right = left + 1;
+    auto       first = slot;
+
+    if (left < size && before(left, first)) {
+      first = left;
+    }
+
+    if (right < size && before(right, first)) {
+      first = right;
+    }
+
+    if (first == slot) {
+      break;
+    }
+
+    swap(slot, first);
+    slot = first;
+  }
+}
+}  // namespace nes
@@ -0,0 +1,291 @@
+#include "trace.h"
+
+#include <algorithm>
+#include <csignal>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include <fmt/format.h>
+
+#include "opcodes.h"
+
+namespace nes {
+
+//
+// File layout: a header, then the records from oldest to newest
+//
+
+namespace {
+struct trace_header {
+  char     magic[8]    = {'N', 'E', 'S', 'T', 'R', 'A', 'C', 'E'};
+  uint32_t version     = 1;
+  uint32_t record_size = sizeof(trace_record);
+  uint64_t count       = 0;
+};
+
+const trace_ring* crash_ring = nullptr;
+char              crash_path[4096];
+
+// Best effort, stdio isn't async-signal-safe but the process is going
+// down anyway. The default action runs once the file is out
+extern "C" void dump_and_raise(int number)
+{
+  std::signal(number, SIG_DFL);
+
+  if (std::FILE* file = std::fopen(crash_path, "wb"); file && crash_ring) {
+    crash_ring->write(file);
+    std::fclose(file);
+  }
+
+  std::raise(number);
+}
+}  // namespace
+
+trace_ring::trace_ring(const size_t size)
+{
+  size_t capacity = 1;
+
+  while (capacity < size) {
+    capacity <<= 1;
+  }
+
+  records = std::make_unique<trace_record[]>(capacity);
+  mask    = capacity - 1;
+}
+
+size_t trace_ring::capacity() const
+{
+  return mask + 1;
+}
+
+void trace_ring::clear()
+{
+  head.store(0, std::memory_order_release);
+}
+
+uint64_t trace_ring::written() const
+{
+  return head.load(std::memory_order_acquire);
+}
+
+const trace_record& trace_ring::at(const uint64_t index) const
+{
+  return records[index & mask];
+}
+
+std::vector<trace_record> trace_ring::snapshot() const
+{
+  const uint64_t end   = head.load(std::memory_order_acquire);
+  const uint64_t begin = end > capacity() ? end - capacity() : 0;
+
+  std::vector<trace_record> result;
+  result.reserve(end - begin);
+
+  for (uint64_t i = begin; i < end; ++i) {
+    result.push_back(records[i & mask]);
+  }
+
+  // Slots the writer came round to in the meantime, the one it may be
+  // halfway through included, don't hold what was read from them
+  const uint64_t now = head.load(std::memory_order_acquire);
+
+  if (now + 1 > begin + capacity()) {
+    const uint64_t lost = std::min(now + 1 - begin - capacity(), end - begin);
+    result.erase(result.begin(), result.begin() + lost);
+  }
+
+  return result;
+}
+
+// No allocation in here, it also runs from the crash handler. Unlike
+// snapshot() it doesn't drop records the writer may be going over
+void trace_ring::write(std::FILE* file) const
+{
+  const uint64_t end   = head.load(std::memory_order_acquire);
+  const uint64_t begin = end > capacity() ? end - capacity() : 0;
+
+  trace_header header;
+  header.count = end - begin;
+
+  std::fwrite(&header, sizeof(header), 1, file);
+
+  const size_t first = begin & mask;
+  const size_t count = end - begin;
+  const size_t split = std::min(count, capacity() - first);
+
+  std::fwrite(&records[first], sizeof(trace_record), split, file);
+  std::fwrite(&records[0], sizeof(trace_record), count - split, file);
+}
+
+void trace_ring::dump(const std::filesystem::path& path) const
+{
+  std::FILE* file = std::fopen(path.string().c_str(), "wb");
+
+  if (!file) {
+    throw std::runtime_error("Can't write the trace");
+  }
+
+  this->write(file);
+  std::fclose(file);
+}
+
+void trace_ring::dump_on_crash(const std::filesystem::path& path)
+{
+  const auto name = path.string();
+
+  if (name.size() >= sizeof(crash_path)) {
+    throw std::runtime_error("Trace path is too long");
+  }
+
+  std::strcpy(crash_path, name.c_str());
+  crash_ring = this;
+
+  for (const auto number : {SIGSEGV, SIGABRT, SIGFPE, SIGILL}) {
+    std::signal(number, dump_and_raise);
+  }
+}
+
+std::vector<trace_record> read_trace(const std::filesystem::path& path)
+{
+  std::ifstream file(path, std::ios::binary);
+  trace_header  header;
+  trace_header  expected;
+
+  file.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+  if (!file || std::memcmp(header.magic, expected.magic, 8) != 0 ||
+      header.version != expected.version ||
+      header.record_size != expected.record_size) {
+    throw std::runtime_error("Not a trace written by this build");
+  }
+
+  std::vector<trace_record> records(header.count);
+  file.read(
+      reinterpret_cast<char*>(records.data()),
+      records.size() * sizeof(trace_record));
+
+  if (!file) {
+    throw std::runtime_error("The trace is truncated");
+  }
+
+  return records;
+}
+
+void write_nestest(std::ostream& out, const trace_record& record)
+{
+  using namespace addressing_mode;
+
+  const auto     inst  = opcodes::mnemonic(record.opcode);
+  const auto     mode  = opcodes::mode(record.opcode);
+  const uint8_t  arg8  = record.operand[0];
+  const uint16_t arg16 = record.operand[0] | (record.operand[1] << 8);
+
+  std::string line = fmt::format("{:04X}  {:02X} ", record.pc, record.opcode);
+
+  switch (mode) {
+    case Absolute:
+    case AbsoluteX:
+    case AbsoluteY:
+    case Indirect:
+      line += fmt::format("{:02X} {:02X} ", arg8, record.operand[1]);
+      break;
+    case IndirectY:
+    case IndirectX:
+    case ZeroPage:
+    case ZeroPageX:
+    case ZeroPageY:
+    case Relative:
+    case Immediate: line += fmt::format("{:02X}    ", arg8); break;
+    default: line += "      "; break;
+  }
+
+  line += fmt::format("{:>4s} ", inst);
+
+  std::string operand;
+
+  switch (mode) {
+    case Accumulator:
+      if (inst == "LSR" || inst == "ASL" || inst == "ROR" || inst == "ROL") {
+        operand = "A";
+      } else {
+        operand = " ";
+      }
+      break;
+    case Immediate: operand = fmt::format("#${:02X}", arg8); break;
+    case ZeroPage:
+      operand = fmt::format("${:02X} = {:02X}", arg8, record.value);
+      break;
+    case ZeroPageX:
+      operand = fmt::format(
+          "${:02X},X @ {:02X} = {:02X}", arg8, record.address, record.value);
+      break;
+    case ZeroPageY:
+      operand = fmt::format(
+          "${:02X},Y @ {:02X} = {:02X}", arg8, record.address, record.value);
+      break;
+    case Relative:
+      operand = fmt::format(
+          "${:04X}",
+          static_cast<uint16_t>(record.pc + 2 + static_cast<int8_t>(arg8)));
+      break;
+    case Absolute:
+      if (inst == "JMP" || inst == "JSR") {
+        operand = fmt::format("${:04X}", arg16);
+      } else {
+        operand = fmt::format("${:04X} = {:02X}", arg16, record.value);
+      }
+      break;
+    case AbsoluteX:
+      operand = fmt::format(
+          "${:04X},X @ {:04X} = {:02X}", arg16, record.address, record.value);
+      break;
+    case AbsoluteY:
+      operand = fmt::format(
+          "${:04X},Y @ {:04X} = {:02X}", arg16, record.address, record.value);
+      break;
+    case Indirect:
+      operand = fmt::format("(${:04X}) = {:04X}", arg16, record.address);
+      break;
+    case IndirectX:
+      operand = fmt::format(
+          "(${:02X},X) @ {:02X} = {:04X} = {:02X}",
+          arg8,
+          static_cast<uint8_t>(arg8 + record.x),
+          record.address,
+          record.value);
+      break;
+    case IndirectY:
+      operand = fmt::format(
+          "(${:02X}),Y = {:04X} @ {:04X} = {:02X}",
+          arg8,
+          static_cast<uint16_t>(record.address - record.y),
+          record.address,
+          record.value);
+      break;
+    default: operand = " "; break;
+  }
+
+  line += fmt::format("{:<28}", operand);
+
+  line += fmt::format(
+      "A:{:02X} X:{:02X} Y:{:02X} P:{:02X} SP:{:02X} CYC:{:3d}\n",
+      record.a,
+      record.x,
+      record.y,
+      record.p | 0x20,
+      record.sp,
+      nestest_dot(record));
+
+  out << line;
+}
+
+// The log starts at cycle 7, once the reset sequence is over, on dot 0
+int nestest_dot(const trace_record& record)
+{
+  return static_cast<int>((record.cycle - 7) * 3 % 341);
+}
+
+}  // namespace nes
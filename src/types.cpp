@@ -8,30 +8,47 @@ namespace nes {
 // CPU (state)
 //
 
-bool state::check_flags(uint8_t flags) const
-{
-  return (this->ps & flags) == flags;
+namespace {
+constexpr uint8_t nz_flags = flags::Negative | flags::Zero;
 }
 
 void state::set_flags(const uint8_t flags)
 {
-  this->ps |= flags;
+  this->p |= flags & ~nz_flags;
+
+  if (flags & flags::Zero) {
+    this->z_result = 0;
+  }
+
+  if (flags & flags::Negative) {
+    this->n_result = 0x80;
+  }
 }
 
 void state::clear_flags(const uint8_t flags)
 {
-  this->ps &= ~flags;
+  this->p &= ~flags;
+
+  if (flags & flags::Zero) {
+    this->z_result = 1;
+  }
+
+  if (flags & flags::Negative) {
+    this->n_result = 0;
+  }
 }
 
 void state::update_nz(const uint8_t value)
 {
-  clear_flags(flags::Zero | flags::Negative);
+  this->n_result = value;
+  this->z_result = value;
+}
 
-  if (value == 0) {
-    set_flags(flags::Zero);
-  } else if (value & 0x80) {
-    set_flags(flags::Negative);
-  }
+// For BIT, which takes N and Z from different values
+void state::update_nz(const uint8_t n_value, const uint8_t z_value)
+{
+  this->n_result = n_value;
+  this->z_result = z_value;
 }
 
 void state::set_a(const uint8_t value)
@@ -59,7 +76,14 @@ void state::set_pc(const uint16_t addr)
 
 void state::set_ps(const uint8_t value)
 {
-  this->ps = value & 0xCF;
+  this->p = value & 0xCF & ~nz_flags;
+  this->update_nz(value & flags::Negative, ~value & flags::Zero);
+}
+
+uint8_t state::ps() const
+{
+  return this->p | (this->n_result & flags::Negative) |
+         (this->z_result ? 0 : flags::Zero);
 }
 
 //
@@ -0,0 +1,40 @@
+#include <fstream>
+#include <iostream>
+
+#include "trace.h"
+
+// Turns a trace dumped by nes::trace_ring into the nestest log format
+//   nes-trace-decode <trace> [log]
+int main(int argc, char** argv)
+{
+  if (argc < 2 || argc > 3) {
+    std::cerr << "usage: nes-trace-decode <trace> [log]\n";
+    return 1;
+  }
+
+  try {
+    const auto records = nes::read_trace(argv[1]);
+
+    std::ofstream log_file;
+
+    if (argc == 3) {
+      log_file.open(argv[2]);
+
+      if (!log_file) {
+        std::cerr << "Can't write " << argv[2] << '\n';
+        return 1;
+      }
+    }
+
+    std::ostream& out = argc == 3 ? log_file : std::cout;
+
+    for (const auto& record : records) {
+      nes::write_nestest(out, record);
+    }
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << '\n';
+    return 1;
+  }
+
+  return 0;
+}